@@ -0,0 +1,427 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include "cppjp.hpp"
+
+/*
+    CPPJP benchmark harness.
+
+    Generates deterministic synthetic corpora in memory and measures the main library
+    operations on each of them. Results are printed as a table and written as JSON so that
+    runs from different releases can be compared.
+
+    Usage: cppjp-bench [output.json] [scale]
+*/
+
+//
+//  Allocation counting
+//
+
+static std::atomic<std::uint64_t> allocation_count{ 0 };
+static std::atomic<std::uint64_t> allocation_bytes{ 0 };
+
+void* operator new(size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+//
+//  Corpus generation
+//
+
+/*
+    xorshift64*, used so that every run generates byte identical corpora
+*/
+class Random
+{
+    public:
+        explicit Random(std::uint64_t seed) : state(seed) {}
+
+        std::uint64_t next()
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            return state * 0x2545F4914F6CDD1DULL;
+        }
+
+        std::uint64_t below(std::uint64_t bound) { return next() % bound; }
+
+    private:
+        std::uint64_t state;
+};
+
+static void AppendNumber(Random& rng, std::string& out)
+{
+    char buffer[64];
+    switch(rng.below(3))
+    {
+        case 0: snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(rng.below(1000000))); break;
+        case 1: snprintf(buffer, sizeof(buffer), "-%llu", static_cast<unsigned long long>(rng.next() >> 12)); break;
+        default: snprintf(buffer, sizeof(buffer), "%.17g", static_cast<double>(rng.next() >> 11) * 0x1.0p-53 * 1e6); break;
+    }
+    out += buffer;
+}
+
+static void AppendString(Random& rng, std::string& out, size_t max_length)
+{
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789 ";
+    size_t length = 1 + rng.below(max_length);
+
+    out += '"';
+    for(size_t i = 0; i < length; i++)
+    {
+        // Roughly one in 32 characters is an escape sequence
+        if(rng.below(32) == 0)
+            out += rng.below(2) ? "\\n" : "\\u00e9";
+        else
+            out += alphabet[rng.below(sizeof(alphabet) - 1)];
+    }
+    out += '"';
+}
+
+static std::string NumbersCorpus(size_t target)
+{
+    Random rng(1);
+    std::string out = "[";
+    while(out.size() < target)
+    {
+        if(out.size() > 1) out += ',';
+        AppendNumber(rng, out);
+    }
+    return out + "]";
+}
+
+static std::string StringsCorpus(size_t target)
+{
+    Random rng(2);
+    std::string out = "[";
+    while(out.size() < target)
+    {
+        if(out.size() > 1) out += ',';
+        AppendString(rng, out, 64);
+    }
+    return out + "]";
+}
+
+static std::string NestedCorpus(size_t target)
+{
+    Random rng(3);
+    std::string out = "[";
+    while(out.size() < target)
+    {
+        if(out.size() > 1) out += ',';
+
+        // Alternate arrays and objects down to a fixed depth
+        const size_t depth = 256;
+        for(size_t level = 0; level < depth; level++)
+            out += level & 1 ? "{\"n\":" : "[";
+        AppendNumber(rng, out);
+        for(size_t level = depth; level > 0; level--)
+            out += (level - 1) & 1 ? "}" : "]";
+    }
+    return out + "]";
+}
+
+static std::string WideObjectCorpus(size_t target)
+{
+    Random rng(4);
+    std::string out = "{";
+    for(size_t i = 0; out.size() < target; i++)
+    {
+        if(i) out += ',';
+        out += "\"key" + std::to_string(i) + "\":";
+        if(rng.below(2)) AppendNumber(rng, out);
+        else AppendString(rng, out, 16);
+    }
+    return out + "}";
+}
+
+static std::string BigArrayCorpus(size_t target)
+{
+    Random rng(5);
+    std::string out = "[";
+    for(size_t i = 0; out.size() < target; i++)
+    {
+        if(i) out += ',';
+        out += "{\"id\":" + std::to_string(i) + ",\"price\":";
+        AppendNumber(rng, out);
+        out += ",\"name\":";
+        AppendString(rng, out, 24);
+        out += rng.below(2) ? ",\"active\":true,\"tags\":[]}" : ",\"active\":false,\"tags\":null}";
+    }
+    return out + "]";
+}
+
+//
+//  Measurement
+//
+
+struct Measurement
+{
+    std::string operation;
+    size_t iterations = 0;
+    size_t bytes_per_iteration = 0;     // 0 for operations that are not measured in throughput
+    std::vector<double> samples_ns;
+    std::uint64_t allocations = 0;
+    std::uint64_t allocated_bytes = 0;
+
+    // Below this many samples the p99 is just the slowest run and is not reported
+    static const size_t min_tail_samples = 100;
+
+    bool hasTail() const { return samples_ns.size() >= min_tail_samples; }
+
+    double percentile(double p) const
+    {
+        std::vector<double> sorted = samples_ns;
+        std::sort(sorted.begin(), sorted.end());
+        size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    double totalNs() const
+    {
+        double total = 0;
+        for(double sample : samples_ns) total += sample;
+        return total;
+    }
+
+    double nsPerOp() const { return totalNs() / iterations; }
+
+    double megabytesPerSecond() const
+    {
+        if(!bytes_per_iteration) return 0;
+        return static_cast<double>(bytes_per_iteration) * iterations / totalNs() * 1e9 / (1024.0 * 1024.0);
+    }
+};
+
+struct CorpusResult
+{
+    std::string name;
+    size_t bytes;
+    std::vector<Measurement> measurements;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double ElapsedNs(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/*
+    Runs op `iterations` times, recording the latency and allocations of each run.
+    setup runs before each iteration and is excluded from the measurement.
+    @param batch The number of operations op performs per run. Samples and allocations are
+    recorded per operation, for operations too short to time one at a time.
+*/
+static Measurement Measure(const char* name, size_t iterations, size_t bytes, const std::function<void()>& setup, const std::function<void()>& op, size_t batch = 1)
+{
+    Measurement measurement;
+    measurement.operation = name;
+    measurement.iterations = iterations;
+    measurement.bytes_per_iteration = bytes;
+    measurement.samples_ns.reserve(iterations);
+
+    for(size_t i = 0; i < iterations; i++)
+    {
+        if(setup) setup();
+
+        std::uint64_t count_before = allocation_count.load();
+        std::uint64_t bytes_before = allocation_bytes.load();
+        Clock::time_point start = Clock::now();
+
+        op();
+
+        double elapsed = ElapsedNs(start);
+        measurement.allocations += allocation_count.load() - count_before;
+        measurement.allocated_bytes += allocation_bytes.load() - bytes_before;
+        measurement.samples_ns.push_back(elapsed / batch);
+    }
+
+    measurement.allocations /= iterations * batch;
+    measurement.allocated_bytes /= iterations * batch;
+
+    return measurement;
+}
+
+static CorpusResult RunCorpus(const char* name, const std::string& text, size_t iterations, size_t lookup_batch)
+{
+    CorpusResult result{ name, text.size(), {} };
+
+    JSON document = JSON::FromJSONString(text.data(), text.size());
+    if(!document.isValid())
+    {
+        fprintf(stderr, "Corpus \"%s\" failed to parse\n", name);
+        exit(1);
+    }
+
+    // Each parsed tree is freed before the next run, outside of the measurement
+    JSONNode* parsed = nullptr;
+    auto free_parsed = [&](){
+        if(parsed) CPPJP::FreeNode(parsed);
+        parsed = nullptr;
+    };
+
+    result.measurements.push_back(Measure("parse", iterations, text.size(), free_parsed, [&](){
+        parsed = JSON::FromJSONString(text.data(), text.size()).release();
+    }));
+    free_parsed();
+
+    JSONParseOptions utf8_options;
+    utf8_options.validate_utf8 = true;
+    result.measurements.push_back(Measure("parse_utf8", iterations, text.size(), free_parsed, [&](){
+        parsed = JSON::FromJSONString(text.data(), text.size(), utf8_options).release();
+    }));
+    free_parsed();
+
+    result.measurements.push_back(Measure("validate", iterations, text.size(), nullptr, [&](){
+        if(!JSON::Validate(text.data(), text.size())) exit(1);
+    }));
+
+    std::string output;
+    result.measurements.push_back(Measure("minify", iterations, text.size(), [&](){ output.clear(); }, [&](){
+        if(!JSON::Minify(text.data(), text.size(), output)) exit(1);
+    }));
+
+    result.measurements.push_back(Measure("writeOut", iterations, text.size(), [&](){ output.clear(); output.shrink_to_fit(); }, [&](){
+        document.writeOut(output);
+    }));
+
+    result.measurements.push_back(Measure("clone", iterations, text.size(), nullptr, [&](){
+        JSONNode* copy = CPPJP::CloneNode(document.borrowNode());
+        CPPJP::FreeNode(copy);
+    }));
+
+    JSONNode* victim = nullptr;
+    result.measurements.push_back(Measure("destroy", iterations, text.size(), [&](){ victim = CPPJP::CloneNode(document.borrowNode()); }, [&](){
+        CPPJP::FreeNode(victim);
+    }));
+
+    // Lookups on the top level container, a batch per run so that the clock is not what is measured
+    Random rng(42);
+    if(document.getType() == JSONNodeType::OBJECT)
+    {
+        std::vector<std::string> keys;
+        document.iterate([&](JSON member){ keys.push_back(member.getName()); });
+
+        std::vector<const char*> picks;
+        for(size_t i = 0; i < lookup_batch; i++) picks.push_back(keys[rng.below(keys.size())].c_str());
+
+        result.measurements.push_back(Measure("getEntry", iterations, 0, nullptr, [&](){
+            for(const char* key : picks)
+                if(!document.getEntry(key).isValid()) exit(1);
+        }, lookup_batch));
+    }
+    else
+    {
+        size_t size = document.arraySize();
+
+        std::vector<size_t> picks;
+        for(size_t i = 0; i < lookup_batch; i++) picks.push_back(rng.below(size));
+
+        result.measurements.push_back(Measure("getElement", iterations, 0, nullptr, [&](){
+            for(size_t index : picks)
+                if(!document.getElement(index).isValid()) exit(1);
+        }, lookup_batch));
+    }
+
+    return result;
+}
+
+//
+//  Reporting
+//
+
+static void PrintResults(const std::vector<CorpusResult>& results)
+{
+    printf("%-12s %-11s %10s %14s %14s %14s %12s %14s\n", "corpus", "operation", "MB/s", "ns/op", "p50 ns", "p99 ns", "allocs/op", "alloc bytes/op");
+    for(const CorpusResult& corpus : results)
+    {
+        for(const Measurement& m : corpus.measurements)
+        {
+            char p99[32] = "-";
+            if(m.hasTail()) snprintf(p99, sizeof(p99), "%.0f", m.percentile(0.99));
+
+            printf("%-12s %-11s %10.1f %14.0f %14.0f %14s %12llu %14llu\n",
+                corpus.name.c_str(), m.operation.c_str(), m.megabytesPerSecond(), m.nsPerOp(),
+                m.percentile(0.5), p99,
+                static_cast<unsigned long long>(m.allocations), static_cast<unsigned long long>(m.allocated_bytes));
+        }
+    }
+}
+
+static bool WriteResults(const char* path, const std::vector<CorpusResult>& results, double scale)
+{
+    FILE* file = fopen(path, "w");
+    if(!file) return false;
+
+    fprintf(file, "{\"scale\":%g,\"corpora\":[", scale);
+    for(size_t c = 0; c < results.size(); c++)
+    {
+        const CorpusResult& corpus = results[c];
+        fprintf(file, "%s{\"name\":\"%s\",\"bytes\":%zu,\"results\":[", c ? "," : "", corpus.name.c_str(), corpus.bytes);
+
+        for(size_t i = 0; i < corpus.measurements.size(); i++)
+        {
+            const Measurement& m = corpus.measurements[i];
+            char p99[32] = "null";
+            if(m.hasTail()) snprintf(p99, sizeof(p99), "%.1f", m.percentile(0.99));
+
+            fprintf(file,
+                "%s{\"operation\":\"%s\",\"iterations\":%zu,\"mb_per_s\":%.3f,\"ns_per_op\":%.1f,"
+                "\"p50_ns\":%.1f,\"p99_ns\":%s,\"allocations_per_op\":%llu,\"allocated_bytes_per_op\":%llu}",
+                i ? "," : "", m.operation.c_str(), m.iterations, m.megabytesPerSecond(), m.nsPerOp(),
+                m.percentile(0.5), p99,
+                static_cast<unsigned long long>(m.allocations), static_cast<unsigned long long>(m.allocated_bytes));
+        }
+
+        fprintf(file, "]}");
+    }
+    fprintf(file, "]}\n");
+
+    return fclose(file) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    const char* output_path = argc > 1 ? argv[1] : "bench-results.json";
+    double scale = argc > 2 ? atof(argv[2]) : 1.0;
+    if(scale <= 0) scale = 1.0;
+
+    size_t size = static_cast<size_t>(4 * 1024 * 1024 * scale);
+    const size_t iterations = Measurement::min_tail_samples;
+    const size_t lookup_batch = 16;
+
+    std::vector<CorpusResult> results;
+    results.push_back(RunCorpus("numbers", NumbersCorpus(size), iterations, lookup_batch));
+    results.push_back(RunCorpus("strings", StringsCorpus(size), iterations, lookup_batch));
+    results.push_back(RunCorpus("nested", NestedCorpus(size), iterations, lookup_batch));
+    results.push_back(RunCorpus("wide_object", WideObjectCorpus(size), iterations, lookup_batch));
+    results.push_back(RunCorpus("big_array", BigArrayCorpus(size), iterations, lookup_batch));
+
+    PrintResults(results);
+
+    if(!WriteResults(output_path, results, scale))
+    {
+        fprintf(stderr, "Unable to write results to \"%s\"\n", output_path);
+        return 1;
+    }
+
+    printf("Results written to %s\n", output_path);
+    return 0;
+}
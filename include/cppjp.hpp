@@ -2,7 +2,13 @@
 
 #include <cstdint>
 #include <string>
+#include <vector>
+#include <iterator>
 #include <functional>
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <string_view>
 
 enum class JSONNodeType
 {
@@ -15,15 +21,430 @@ enum class JSONNodeType
     JNULL
 };
 
+/**
+ * Bits of `JSONNode::flags`.
+ */
+enum JSONNodeFlag : std::uint16_t
+{
+    NODE_HAS_ESCAPES    = 1 << 0,   // string_data contains escape sequences
+    NODE_DECODED        = 1 << 1,   // extra->decoded_data holds the decoded string_data
+    NODE_HASHED         = 1 << 2,   // hash holds the structural hash of the subtree
+    NODE_INT64          = 1 << 3,   // number holds the value of a NUMBER as int64
+    NODE_UINT64         = 1 << 4,   // number holds the value of a NUMBER as uint64
+    NODE_DOUBLE         = 1 << 5,   // number holds the value of a NUMBER as real
+    NODE_FORMATTED      = 1 << 6,   // string_data holds the text of a binary number
+    NODE_CHECKPOINT     = 1 << 7,   // The node is listed in the source checkpoints of its parent
+    NODE_SOURCE_CLEAN   = 1 << 8    // The subtree is unchanged since it was parsed from its source span
+};
+
+/**
+ * Binary value of a number node set through `setInt64()`, `setUint64()` or
+ * `setDouble()`. Which member is active is given by the node's flags.
+ */
+union JSONNumber
+{
+    std::int64_t int64;
+    std::uint64_t uint64;
+    double real;
+};
+
+struct JSONNode;
+
+/**
+ * A child of a large container parsed with `track_source`, recorded with its
+ * offset from the container so that children can be found without walking
+ * every sibling before them.
+ */
+struct JSONSourceCheckpoint
+{
+    JSONNode* node;
+    size_t offset;
+};
+
+/**
+ * Node data that most nodes never need, kept out of line so that it costs a
+ * node one pointer until it is first used.
+ */
+struct JSONNodeExtra
+{
+    std::string decoded_data;       // Decoded string contents, filled on first read of an escaped string
+    size_t source_offset = 0;       // Start in the source text, relative to the start of the previous sibling, or of the parent for a first child
+    size_t source_length = 0;       // Length of the value in the source text, both only set when parsed with track_source
+    std::unique_ptr<std::vector<JSONSourceCheckpoint>> checkpoints;  // Every 64th child in order, built by JSONDocument
+};
+
 struct JSONNode
 {
-    std::string name;
+    std::string name;               // Member name with escapes decoded, they are escaped again when written
     JSONNodeType type;
+    std::uint16_t flags = 0;
+    std::uint16_t name_hash = 0;    // CPPJP::NameHash() of name, 0 if not known; reset it when changing name directly
     JSONNode* parent;
     JSONNode* next = nullptr;
     JSONNode* previous = nullptr;
     JSONNode* child = nullptr;
-    std::string string_data;
+    std::string string_data;        // Number text, or string contents as written in JSON, escapes included
+    std::uint64_t hash = 0;         // Cached structural hash, valid when NODE_HASHED is set
+    JSONNumber number = {};         // Value of a number set in binary, string_data is formatted from it on first use
+    std::unique_ptr<JSONNodeExtra> extra;   // Allocated for escaped strings once decoded, and for every node parsed with track_source
+};
+
+/**
+ * Reasons JSON text can be rejected.
+ */
+enum class JSONError
+{
+    NONE,
+    UNEXPECTED_END,
+    UNEXPECTED_CHARACTER,
+    INVALID_STRING,
+    INVALID_ESCAPE,
+    INVALID_NUMBER,
+    NESTING_TOO_DEEP,
+    TRAILING_CHARACTERS,
+    INVALID_UTF8,
+    TYPE_MISMATCH,
+    READ_FAILED,
+    TOO_MANY_NODES,
+    STRING_TOO_LONG,
+    MEMORY_BUDGET_EXCEEDED,
+    INVALID_ENCODING
+};
+
+/**
+ * The outcome of validating or parsing JSON text.
+ */
+struct JSONStatus
+{
+    JSONError error = JSONError::NONE;
+    size_t offset = 0;      // Byte offset of the error in the input
+
+    bool ok() const { return error == JSONError::NONE; }
+    explicit operator bool() const { return ok(); }
+};
+
+/**
+ * Counters filled in by the library while a JSONStats object is attached to
+ * the calling thread with `CPPJP::SetStats()`. Collection is only compiled in
+ * when the library is built with `CPPJP_STATS` defined (`make STATS=1`);
+ * otherwise the counters are never touched.
+ */
+struct JSONStats
+{
+    std::uint64_t bytes_parsed = 0;         // Input bytes handed to ParseJSON
+    std::uint64_t bytes_written = 0;        // Output bytes produced by WriteJson
+    std::uint64_t nodes_by_type[7] = {};    // Parsed nodes, indexed by JSONNodeType
+    std::uint64_t nodes_cloned = 0;         // Nodes created by CloneNode
+    std::uint64_t nodes_freed = 0;          // Nodes deleted by FreeNode
+    std::uint64_t max_depth = 0;            // Deepest nesting seen while parsing, the root has depth 0
+    std::uint64_t allocations = 0;          // Heap allocations made for parsed and cloned trees
+    std::uint64_t allocated_bytes = 0;      // Bytes of those allocations
+
+    std::uint64_t parse_ns = 0;
+    std::uint64_t write_ns = 0;
+    std::uint64_t clone_ns = 0;
+    std::uint64_t free_ns = 0;
+};
+
+struct JSONParseOptions
+{
+    /**
+     * Number of threads used to parse a top level array or object.
+     * `1` parses sequentially, `0` uses one thread per available core.
+     * Small inputs and inputs that can not be split are always parsed
+     * sequentially; the resulting tree is identical in either case.
+     */
+    unsigned threads = 1;
+
+    /**
+     * Rejects strings and names that are not well formed UTF-8, including
+     * overlong encodings, surrogates and truncated sequences.
+     */
+    bool validate_utf8 = false;
+
+    /*
+     * Limits for parsing untrusted input. A parse that would exceed one of
+     * them stops at the offending token and fails with the matching error,
+     * so the memory a document can take is bounded before it is allocated.
+     * `0` means no limit.
+     */
+
+    /**
+     * Maximum number of arrays and objects nested inside each other.
+     * Exceeding it fails with `JSONError::NESTING_TOO_DEEP`.
+     */
+    size_t max_depth = 0;
+
+    /**
+     * Maximum number of nodes in the tree, the root included.
+     * Exceeding it fails with `JSONError::TOO_MANY_NODES`.
+     */
+    size_t max_nodes = 0;
+
+    /**
+     * Maximum length of a string or object name in bytes, as written in
+     * the input. Exceeding it fails with `JSONError::STRING_TOO_LONG`.
+     */
+    size_t max_string_length = 0;
+
+    /**
+     * Maximum memory for the tree, counted as `sizeof(JSONNode)` per node
+     * plus the bytes of every name, string and number text. Exceeding it
+     * fails with `JSONError::MEMORY_BUDGET_EXCEEDED`.
+     */
+    size_t max_total_bytes = 0;
+
+    /**
+     * Records where every value was found in the input, in the
+     * `source_offset` and `source_length` of each node's `extra` data.
+     * Offsets are stored relative to the previous sibling, or to the parent
+     * for a first child, so that edits only need to adjust a few of them;
+     * the root's offset is absolute. Nodes are also marked as unchanged,
+     * which lets `JSON::writeOut(output, source)` copy unmodified subtrees
+     * verbatim.
+     */
+    bool track_source = false;
+};
+
+namespace CPPJP
+{
+    /**
+     * Hashes an object key (64 bit FNV-1a). Usable in constant expressions
+     * so the hashes of known keys can be computed at compile time.
+     * @param key The key to hash
+     * @param length The number of bytes in key
+     * @return The hash of the key.
+     */
+    constexpr std::uint64_t HashKey(const char* key, size_t length)
+    {
+        std::uint64_t hash = 0xCBF29CE484222325ull;
+        for(size_t i = 0; i < length; i++)
+        {
+            hash ^= static_cast<unsigned char>(key[i]);
+            hash *= 0x100000001B3ull;
+        }
+        return hash;
+    }
+
+    /**
+     * Folds a key hash to the 16 bits kept in `JSONNode::name_hash`. Never
+     * 0, which marks a name whose hash is not known.
+     * @param hash The hash of the key, see `HashKey()`
+     * @return The folded hash.
+     */
+    constexpr std::uint16_t FoldKeyHash(std::uint64_t hash)
+    {
+        std::uint16_t folded = static_cast<std::uint16_t>(hash ^ (hash >> 16) ^ (hash >> 32) ^ (hash >> 48));
+        return folded ? folded : 1;
+    }
+
+    /**
+     * Computes the value kept in `JSONNode::name_hash` for a member name.
+     * @param name The decoded member name
+     * @return The folded hash of the name.
+     */
+    inline std::uint16_t NameHash(const std::string& name)
+    {
+        return FoldKeyHash(HashKey(name.data(), name.size()));
+    }
+}
+
+/**
+ * An object key whose length and hash are computed once, at compile time
+ * when constructed from a string literal. Declare keys used on hot paths as
+ * constants and look them up with `JSON::get()`:
+ *
+ *     constexpr JSONKey user_key = "user";
+ *     JSON user = request.get(user_key);
+ */
+struct JSONKey
+{
+    const char* data;
+    size_t length;
+    std::uint64_t hash;
+
+    template<size_t N>
+    constexpr JSONKey(const char (&key)[N])
+        : data(key), length(N - 1), hash(CPPJP::HashKey(key, N - 1))
+    {}
+
+    constexpr JSONKey(const char* key, size_t length)
+        : data(key), length(length), hash(CPPJP::HashKey(key, length))
+    {}
+};
+
+/**
+ * Forward iterator over the children of an array or object, yielding the
+ * child nodes. The following child is read before the current one is
+ * handed out, so the current child may be erased while iterating.
+ */
+class JSONIterator
+{
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = JSONNode;
+        using difference_type = std::ptrdiff_t;
+        using pointer = JSONNode*;
+        using reference = JSONNode&;
+
+        JSONIterator() = default;
+        explicit JSONIterator(JSONNode* first) : current(first), following(first ? first->next : nullptr) {}
+
+        reference operator*() const { return *current; }
+        pointer operator->() const { return current; }
+
+        JSONIterator& operator++()
+        {
+            current = following;
+            following = current ? current->next : nullptr;
+            return *this;
+        }
+
+        JSONIterator operator++(int)
+        {
+            JSONIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const JSONIterator& other) const { return current == other.current; }
+        bool operator!=(const JSONIterator& other) const { return current != other.current; }
+
+    private:
+        JSONNode* current = nullptr;
+        JSONNode* following = nullptr;
+};
+
+/**
+ * An object member as yielded by `JSON::items()`.
+ */
+struct JSONMember
+{
+    std::string_view key;
+    JSONNode& value;
+};
+
+/**
+ * Iterator over the members of an object, yielding `JSONMember` views. Like
+ * `JSONIterator`, the current member may be erased while iterating.
+ */
+class JSONMemberIterator
+{
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = JSONMember;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = JSONMember;
+
+        JSONMemberIterator() = default;
+        explicit JSONMemberIterator(JSONNode* first) : children(first) {}
+
+        JSONMember operator*() const { return JSONMember{ children->name, *children }; }
+
+        JSONMemberIterator& operator++()
+        {
+            ++children;
+            return *this;
+        }
+
+        bool operator==(const JSONMemberIterator& other) const { return children == other.children; }
+        bool operator!=(const JSONMemberIterator& other) const { return children != other.children; }
+
+    private:
+        JSONIterator children;
+};
+
+/**
+ * One field of every element of an array, as returned by
+ * `JSON::extractColumn()`. `values` is contiguous and has one entry per
+ * element. Elements that are not objects, lack the field or hold a value of
+ * another type get `T{}` and a cleared bit in `validity`, which holds bit
+ * `i % 64` of element `i` in word `i / 64`.
+ */
+template<typename T>
+struct JSONColumn
+{
+    std::vector<T> values;
+    std::vector<std::uint64_t> validity;
+    size_t valid_count = 0;
+
+    size_t size() const { return values.size(); }
+    bool isValid(size_t index) const { return (validity[index / 64] >> (index % 64)) & 1; }
+};
+
+/**
+ * Depth first, pre-order iterator over all descendants of a node. Nodes must
+ * not be erased or added while iterating.
+ */
+class JSONTreeIterator
+{
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = JSONNode;
+        using difference_type = std::ptrdiff_t;
+        using pointer = JSONNode*;
+        using reference = JSONNode&;
+
+        JSONTreeIterator() = default;
+        explicit JSONTreeIterator(JSONNode* root) : root(root), current(root ? root->child : nullptr), current_depth(1) {}
+
+        reference operator*() const { return *current; }
+        pointer operator->() const { return current; }
+
+        /**
+         * @return The depth of the current node below the root, children of
+         * the root have a depth of 1.
+         */
+        size_t depth() const { return current_depth; }
+
+        JSONTreeIterator& operator++()
+        {
+            if(current->child)
+            {
+                current = current->child;
+                current_depth++;
+                return *this;
+            }
+
+            // Walk back up until a sibling is available
+            while(current != root && !current->next)
+            {
+                current = current->parent;
+                current_depth--;
+            }
+
+            current = current == root ? nullptr : current->next;
+            return *this;
+        }
+
+        JSONTreeIterator operator++(int)
+        {
+            JSONTreeIterator previous = *this;
+            ++*this;
+            return previous;
+        }
+
+        bool operator==(const JSONTreeIterator& other) const { return current == other.current; }
+        bool operator!=(const JSONTreeIterator& other) const { return current != other.current; }
+
+    private:
+        JSONNode* root = nullptr;
+        JSONNode* current = nullptr;
+        size_t current_depth = 0;
+};
+
+/**
+ * A pair of iterators usable in a range based for loop.
+ */
+template<typename Iterator>
+struct JSONRange
+{
+    Iterator first;
+    Iterator last;
+
+    Iterator begin() const { return first; }
+    Iterator end() const { return last; }
 };
 
 class JSON
@@ -37,6 +458,119 @@ class JSON
      */
     static JSON FromJSONString(const char* str);
 
+    /**
+     * Creates an owning JSON object by parsing `length` bytes of JSON text.
+     * @param str The JSON text to parse. Does not need to be null terminated.
+     * @param length The number of bytes in `str`.
+     * @param options Options controlling the parse.
+     * @param status If not null, receives the error and its byte offset when
+     * parsing fails.
+     * @return The parsed JSON object.
+     */
+    static JSON FromJSONString(const char* str, size_t length, const JSONParseOptions& options = {}, JSONStatus* status = nullptr);
+
+    /**
+     * Creates an owning JSON object by parsing everything read from a file
+     * descriptor until end of file. A background thread reads ahead into a
+     * second buffer while the parser works through the current one, so the
+     * input never has to be held in memory as a whole.
+     * @param fd The file descriptor to read from. It is not closed.
+     * @param options Options controlling the parse. `threads` is ignored.
+     * @param status If not null, receives the error and its byte offset when
+     * parsing or reading fails.
+     * @return The parsed JSON object, or an invalid object on failure.
+     */
+    static JSON FromStream(int fd, const JSONParseOptions& options = {}, JSONStatus* status = nullptr);
+
+    /**
+     * Creates an owning JSON object by parsing everything read from a stream
+     * until end of file, reading ahead on a background thread.
+     * @param stream The stream to read from.
+     * @param options Options controlling the parse. `threads` is ignored.
+     * @param status If not null, receives the error and its byte offset when
+     * parsing or reading fails.
+     * @return The parsed JSON object, or an invalid object on failure.
+     */
+    static JSON FromStream(std::istream& stream, const JSONParseOptions& options = {}, JSONStatus* status = nullptr);
+
+    /**
+     * Checks that `length` bytes of text form exactly one valid JSON value.
+     * Runs the full grammar, escape and number checks without building a
+     * tree or allocating any memory. Strings and names are also checked for
+     * UTF-8, which makes this stricter than `FromJSONString()` with default
+     * options; use the overload taking `JSONParseOptions` to match a parse.
+     * @param str The JSON text to check. Does not need to be null terminated.
+     * @param length The number of bytes in `str`.
+     * @return The validation result, with the byte offset of the first error.
+     */
+    static JSONStatus Validate(const char* str, size_t length);
+
+    /**
+     * Checks `length` bytes of text like `Validate(str, length)`, checking
+     * UTF-8 only if `options.validate_utf8` is set, so that text accepted
+     * here is accepted by a parse with the same options. The limits and
+     * `threads` are ignored.
+     * @param str The JSON text to check. Does not need to be null terminated.
+     * @param length The number of bytes in `str`.
+     * @param options The options the text would be parsed with.
+     * @return The validation result, with the byte offset of the first error.
+     */
+    static JSONStatus Validate(const char* str, size_t length, const JSONParseOptions& options);
+
+    /**
+     * Appends `length` bytes of JSON text to `out` with all whitespace
+     * between tokens removed. The text is validated in the same pass and no
+     * tree is built.
+     * @param str The JSON text. Does not need to be null terminated.
+     * @param length The number of bytes in `str`.
+     * @param out The buffer to append to. Left unchanged if the text is
+     * invalid.
+     * @return The validation result, with the byte offset of the first error.
+     */
+    static JSONStatus Minify(const char* str, size_t length, std::string& out);
+
+    /**
+     * Appends `length` bytes of JSON text to `out` pretty-printed, with one
+     * value or member per line. Like `Minify()` it validates the text in
+     * the same pass and builds no tree.
+     * @param str The JSON text. Does not need to be null terminated.
+     * @param length The number of bytes in `str`.
+     * @param out The buffer to append to. Left unchanged if the text is
+     * invalid.
+     * @param indent The number of spaces to indent each level by.
+     * @return The validation result, with the byte offset of the first error.
+     */
+    static JSONStatus Reformat(const char* str, size_t length, std::string& out, unsigned indent = 4);
+
+    /**
+     * Builds a tree from a MessagePack encoded value. Map keys must be
+     * strings, binary data and extension types other than the number text
+     * written by `toMessagePack()` are rejected with
+     * `JSONError::INVALID_ENCODING`. Infinite and NaN floats become null.
+     * @param data The encoded bytes.
+     * @param length The number of bytes in `data`.
+     * @param options The limits to enforce. `threads`, `validate_utf8` and
+     * `track_source` are ignored; strings are always checked for UTF-8.
+     * @param status If not null, receives the error and its byte offset when
+     * decoding fails.
+     * @return The decoded JSON object, or an invalid object on failure.
+     */
+    static JSON FromMessagePack(const char* data, size_t length, const JSONParseOptions& options = {}, JSONStatus* status = nullptr);
+
+    /**
+     * Builds a tree from a CBOR encoded value. Definite and indefinite
+     * length items are accepted. Map keys must be text strings, and byte
+     * strings are only accepted under tag 262 as number text; other tags
+     * are ignored. Infinite and NaN floats become null.
+     * @param data The encoded bytes.
+     * @param length The number of bytes in `data`.
+     * @param options The limits to enforce, as for `FromMessagePack()`.
+     * @param status If not null, receives the error and its byte offset when
+     * decoding fails.
+     * @return The decoded JSON object, or an invalid object on failure.
+     */
+    static JSON FromCBOR(const char* data, size_t length, const JSONParseOptions& options = {}, JSONStatus* status = nullptr);
+
     /**
      * Creates a non-owning JSON object that wraps a JSON node.
      * @param node The node to wrap.
@@ -92,6 +626,11 @@ class JSON
     const std::string& getName() const;
     const char* getNameCString() const;
 
+    /**
+     * Returns the contents of this JSON string with escape sequences decoded.
+     * Strings containing escapes are decoded on first access and the result
+     * is cached in the node.
+     */
     std::string asString() const;
     const char* asCString() const;
     std::uintmax_t asNumber() const;
@@ -116,6 +655,31 @@ class JSON
     JSONNode* getRawEntry(const char* key);
     JSONNode* getRawElement(size_t index);
 
+    /**
+     * Looks up an object entry by a precomputed key. Member names are
+     * compared by length before any bytes are compared.
+     * @param key The key to find.
+     * @return A non-owning view of the entry, invalid if it is absent.
+     */
+    JSON get(const JSONKey& key);
+
+    /**
+     * Extracts one field from every object in this JSON array in a single
+     * pass, into a contiguous vector with a validity bitmap. Numbers are
+     * converted as by `tryAsDouble()` and `tryAsInt64()`, so `std::int64_t`
+     * columns only accept integers. `std::string_view` columns hold decoded
+     * string contents and remain valid only while the tree retains the
+     * nodes.
+     * @tparam T `double`, `std::int64_t` or `std::string_view`.
+     * @param key The member name, unescaped.
+     * @return The column, with one entry per array element.
+     */
+    template<typename T>
+    JSONColumn<T> extractColumn(const char* key);
+
+    template<typename T>
+    JSONColumn<T> extractColumn(const JSONKey& key);
+
     /**
      * Iterates over this JSON array or object.
      *
@@ -124,10 +688,223 @@ class JSON
      */
     void iterate(std::function<void(JSON node)> callback);
 
+    /**
+     * Iterators over the child nodes of this JSON array or object. The
+     * current child may be erased; modifying or erasing any other node in
+     * the iterated tree invalidates the iteration.
+     */
+    JSONIterator begin();
+    JSONIterator end() { return JSONIterator(); }
+
+    /**
+     * @return A range over the members of this JSON object as name and node
+     * pairs. The current member may be erased while iterating.
+     */
+    JSONRange<JSONMemberIterator> items();
+
+    /**
+     * @return A depth first range over every node below this one, in
+     * document order. The tree must not be modified while iterating.
+     */
+    JSONRange<JSONTreeIterator> descendants();
+
+    /**
+     * Calls `callback(JSONNode&)` for every child of this JSON array or
+     * object. Unlike `iterate()` the callback can be inlined. The callback
+     * may erase the node it is given.
+     */
+    template<typename F>
+    void forEach(F&& callback)
+    {
+        for(JSONIterator current = begin(), last = end(); current != last; ++current)
+            callback(*current);
+    }
+
+    /**
+     * Calls `callback(JSONNode&)` for every child of this JSON array or
+     * object, spreading the children across the shared work stealing thread
+     * pool. Calls for different children run concurrently, so the callback
+     * must be safe to run in parallel; it may read and modify the value of
+     * the node it is given and of the nodes below it, but must not use any
+     * other node or add or erase nodes. The hashes cached in this node and
+     * its ancestors are dropped before the callbacks run, so that changes
+     * made by them stop at the node they were given.
+     * The first exception thrown by a callback is rethrown.
+     * @param callback The function to call for every child.
+     * @param threads The maximum number of threads to use, `0` for all.
+     */
+    template<typename F>
+    void parallelForEach(F&& callback, unsigned threads = 0);
+
+    /**
+     * Maps every child of this JSON array or object to a value and combines
+     * the values, in parallel on the shared thread pool. Each range of
+     * children is folded from `identity` as `combine(partial, map(node))`
+     * and the partial results are combined in order, so `combine` must be
+     * associative but need not be commutative. The same restrictions as
+     * `parallelForEach()` apply to `map`.
+     * @param identity The identity value of combine.
+     * @param map Called as `map(const JSONNode&)`, returns a T.
+     * @param combine Called as `combine(T, T)`, returns a T.
+     * @param threads The maximum number of threads to use, `0` for all.
+     * @return The combined value, `identity` if there are no children.
+     */
+    template<typename T, typename Map, typename Combine>
+    T parallelReduce(T identity, Map&& map, Combine&& combine, unsigned threads = 0);
+
+    /**
+     * Appends a node to the end of this JSON array or object. The node is
+     * detached from its tree if it has one and ownership passes to this
+     * tree. When appending to an object the node keeps its current name.
+     * @param child An owning JSON object, or a view of a node with a parent.
+     */
+    void append(JSON&& child);
+
+    /**
+     * Appends a member to this JSON object, see `append(JSON&&)`.
+     * @param name The name of the new member, unescaped. Characters that
+     * need it are escaped when the tree is written.
+     * @param child The member value.
+     */
+    void append(const char* name, JSON&& child);
+
+    /**
+     * Applies a JSON Merge Patch (RFC 7386) to this node in place. Only the
+     * members named in the patch are visited, so the cost is proportional
+     * to the size of the patch rather than of this document. The patch is
+     * copied from.
+     * @param patch The merge patch.
+     */
+    void applyMergePatch(const JSON& patch);
+
+    /**
+     * Applies a JSON Merge Patch, moving nodes out of the patch instead of
+     * copying them when the patch owns its tree. The patch is left valid
+     * but with unspecified contents.
+     * @param patch The merge patch.
+     */
+    void applyMergePatch(JSON&& patch);
+
+    /**
+     * Replaces this node with a JSON string, escaping `value` as needed.
+     * Any children of the node are freed.
+     * @param value The new, unescaped string contents.
+     */
+    void setString(const std::string& value);
+
+    /**
+     * Replaces this node with a JSON number holding `value`. The value is
+     * stored in binary and only converted to text when it is written out.
+     * Any children of the node are freed.
+     * @param value The new value.
+     */
+    void setInt64(std::int64_t value);
+
+    /**
+     * Replaces this node with a JSON number holding `value`. The value is
+     * stored in binary and only converted to text when it is written out.
+     * Any children of the node are freed.
+     * @param value The new value.
+     */
+    void setUint64(std::uint64_t value);
+
+    /**
+     * Replaces this node with a JSON number holding `value`. The value is
+     * stored in binary and written out as the shortest text that parses
+     * back to exactly the same double. JSON can not represent infinities
+     * and NaN, so those replace the node with `null` instead.
+     * Any children of the node are freed.
+     * @param value The new value.
+     */
+    void setDouble(double value);
+
+    /**
+     * Non-throwing accessors. Each returns an empty optional instead of
+     * throwing when this object is invalid, the node has the wrong type, the
+     * entry or element does not exist, or a number does not fit the requested
+     * type. None of them allocate, except that the first read of a string
+     * with escape sequences decodes it into the node's cache.
+     *
+     * `tryAsInt64()` and `tryAsUint64()` only accept numbers written as
+     * integers. The views returned by `tryAsStringView()` and the JSON
+     * objects returned by `tryGetEntry()` and `tryGetElement()` are
+     * non-owning and remain valid only while the tree retains the node.
+     */
+    std::optional<JSONNodeType> tryGetType() const noexcept;
+    std::optional<JSON> tryGetEntry(const char* key) noexcept;
+    std::optional<JSON> tryGet(const JSONKey& key) noexcept;
+    std::optional<JSON> tryGetElement(size_t index) noexcept;
+    std::optional<std::string_view> tryAsStringView() const;
+    std::optional<std::int64_t> tryAsInt64() const noexcept;
+    std::optional<std::uint64_t> tryAsUint64() const noexcept;
+    std::optional<double> tryAsDouble() const noexcept;
+    std::optional<bool> tryAsBool() const noexcept;
+
     std::string asPrintable() const;
 
     void writeOut(std::string& output_buffer) const;
 
+    /**
+     * Writes this node out like `writeOut(output_buffer)`, but copies every
+     * subtree that is unchanged since it was parsed straight from `source`
+     * instead of regenerating it. Only nodes on the path to a modification
+     * are written out token by token, so patching one field of a large
+     * document costs little more than a copy. Copied subtrees keep their
+     * original whitespace and escaping.
+     * @param output_buffer The buffer the JSON text is appended to.
+     * @param source The text this tree was parsed from with
+     * `JSONParseOptions::track_source`.
+     */
+    void writeOut(std::string& output_buffer, std::string_view source) const;
+
+    /**
+     * Appends this node and its descendants to `out` as MessagePack.
+     * Numbers are written as integers or floats when those convert back to
+     * their exact text, and as text in extension type 1 otherwise, so
+     * `FromMessagePack()` reproduces the document exactly.
+     * @param out The buffer the encoded bytes are appended to.
+     * @throws std::length_error if a string or container is larger than
+     * MessagePack can describe.
+     */
+    void toMessagePack(std::string& out) const;
+
+    /**
+     * Appends this node and its descendants to `out` as CBOR with definite
+     * lengths. Numbers that do not convert to an integer or float exactly
+     * are written as a byte string of their text under tag 262.
+     * @param out The buffer the encoded bytes are appended to.
+     */
+    void toCBOR(std::string& out) const;
+
+    /**
+     * Computes a structural hash of this node's value and its descendants.
+     * Member order, whitespace and the way characters in strings and member
+     * names are escaped do not affect the hash; the node's own name is not
+     * included. Hashes are cached in the nodes, so hashing an unchanged tree
+     * again is O(1).
+     * @return The hash of this node.
+     */
+    std::uint64_t hash() const;
+
+    /**
+     * Compares the values of two nodes and their descendants, ignoring
+     * member order, whitespace and the escaping of strings and names, so a
+     * tree equals its own MessagePack or CBOR round trip. Numbers are
+     * compared by their text. Nodes whose cached hashes differ are rejected
+     * in O(1); equal hashes are confirmed by an O(n) walk of both trees that
+     * compares values without serialising them.
+     * @param other The node to compare against.
+     * @return `true` if both nodes hold the same JSON value.
+     */
+    bool deepEquals(const JSON& other) const;
+
+    /**
+     * Calculates the heap memory used by this node and all of its
+     * descendants, including node structures and string storage.
+     * @return The number of bytes used.
+     */
+    size_t memoryUsage() const;
+
     JSON(const JSON& src);
     JSON(JSON&& src) noexcept;
     ~JSON();
@@ -141,6 +918,16 @@ class JSON
         bool is_valid;      // Is the JSONNode data valid?
 
     JSON() noexcept;
+
+    /*
+        Collects the children of this array or object so they can be split into ranges.
+    */
+    std::vector<JSONNode*> collectChildren();
+
+    /*
+        Number of ranges to split count children into for the parallel algorithms.
+    */
+    static size_t ParallelRangeCount(size_t count);
 };
 
 namespace CPPJP
@@ -153,6 +940,53 @@ namespace CPPJP
      */
     bool ParseJSON(const char* json_str, JSONNode* dest);
 
+    /**
+     * Parses `length` bytes of JSON data into a JSON Node object.
+     * @param json_str The JSON text to parse, does not need to be null terminated
+     * @param length The number of bytes in json_str
+     * @param dest The destination for the resulting JSON structure
+     * @param options Options controlling the parse
+     * @param status If not null, receives the error and its byte offset on failure
+     * @return ```true``` if successful, ```false``` otherwise.
+     */
+    bool ParseJSON(const char* json_str, size_t length, JSONNode* dest, const JSONParseOptions& options, JSONStatus* status = nullptr);
+
+    /**
+     * Checks that `length` bytes of text form exactly one valid JSON value
+     * without allocating any memory.
+     * @param json_str The JSON text to check
+     * @param length The number of bytes in json_str
+     * @param check_utf8 Whether strings and names must be well formed UTF-8
+     * @return The validation result, with the byte offset of the first error.
+     */
+    JSONStatus Validate(const char* json_str, size_t length, bool check_utf8 = true);
+
+    /**
+     * @return A human readable description of a JSONError.
+     */
+    const char* ErrorCString(JSONError error);
+
+    /**
+     * Decodes the escape sequences in the contents of a JSON string. `\uXXXX`
+     * escapes are converted to UTF-8, combining surrogate pairs; unpaired
+     * surrogates become U+FFFD.
+     * @param str The string contents, without the surrounding quotes
+     * @param length The number of bytes in str
+     * @param out The buffer the decoded text is appended to
+     * @return ```false``` if str contains a malformed escape sequence, ```true``` otherwise.
+     */
+    bool DecodeString(const char* str, size_t length, std::string& out);
+
+    /**
+     * Escapes text for use as the contents of a JSON string. Quotes,
+     * backslashes and control characters are escaped; everything else,
+     * including non-ASCII UTF-8, is copied unchanged.
+     * @param str The text to escape
+     * @param length The number of bytes in str
+     * @param out The buffer the escaped text is appended to
+     */
+    void EscapeString(const char* str, size_t length, std::string& out);
+
     /**
      * Clones (deep copies) a JSON node.
      * @param node The node to clone.
@@ -167,9 +1001,118 @@ namespace CPPJP
      */
     JSONNode* DetachNode(JSONNode* node);
 
+    /**
+     * Appends a detached node as the last child of parent.
+     * @param parent The array or object to append to.
+     * @param node The node to append, which must not have a parent.
+     */
+    void AppendNode(JSONNode* parent, JSONNode* node);
+
+    /**
+     * Applies a JSON Merge Patch (RFC 7386) to target in place.
+     * @param target The node to patch.
+     * @param patch The merge patch.
+     * @param move If ```true``` nodes are moved out of patch instead of copied.
+     */
+    void MergePatch(JSONNode* target, JSONNode* patch, bool move);
+
+    /**
+     * Marks a node as modified, dropping the cached hashes of the node and
+     * its ancestors. The library calls this for its own modifications; call
+     * it after changing a node's fields directly.
+     * @param node The modified node.
+     */
+    void TouchNode(JSONNode* node);
+
+    /**
+     * Computes the structural hash of a node, see `JSON::hash()`.
+     */
+    std::uint64_t HashNode(JSONNode* node);
+
+    /**
+     * Compares two nodes structurally, see `JSON::deepEquals()`.
+     */
+    bool NodesEqual(JSONNode* a, JSONNode* b);
+
     /**
      * Frees the memory of a node and all of its sub nodes.
      * @param node The node to be deleted.
      */
     void FreeNode(JSONNode* node);
+
+    /**
+     * Calculates the heap memory used by a node and all of its sub nodes.
+     * @param node The root of the subtree to measure.
+     * @return The number of bytes used.
+     */
+    size_t MemoryUsage(JSONNode* node);
+
+    /**
+     * Attaches a statistics sink to the calling thread. ParseJSON, WriteJson,
+     * CloneNode and FreeNode add to its counters until it is detached by
+     * passing ```nullptr```. Has no effect unless statistics are compiled in.
+     * @param stats The sink to fill, or ```nullptr``` to stop collecting.
+     */
+    void SetStats(JSONStats* stats);
+
+    /**
+     * @return ```true``` if the library was built with statistics collection.
+     */
+    bool StatsEnabled();
+
+    /**
+     * Runs `task(i)` for every `i` in `[0, task_count)` on the shared work
+     * stealing thread pool, the calling thread included, and returns when all
+     * tasks have finished. Batches started from inside a task run
+     * sequentially on that task's thread.
+     * @param task_count The number of tasks
+     * @param threads The maximum number of threads to use, ```0``` for all
+     * @param task The task to run
+     */
+    void RunParallel(size_t task_count, unsigned threads, const std::function<void(size_t)>& task);
+}
+
+template<typename F>
+void JSON::parallelForEach(F&& callback, unsigned threads)
+{
+    std::vector<JSONNode*> children = collectChildren();
+    size_t range_count = ParallelRangeCount(children.size());
+
+    // Touching a child then finds nothing to clear above it, instead of every thread
+    // clearing the flags of this node and its ancestors
+    CPPJP::TouchNode(node);
+
+    CPPJP::RunParallel(range_count, threads, [&](size_t range)
+    {
+        size_t first = children.size() * range / range_count;
+        size_t last = children.size() * (range + 1) / range_count;
+
+        for(size_t i = first; i < last; i++)
+            callback(*children[i]);
+    });
+}
+
+template<typename T, typename Map, typename Combine>
+T JSON::parallelReduce(T identity, Map&& map, Combine&& combine, unsigned threads)
+{
+    std::vector<JSONNode*> children = collectChildren();
+    size_t range_count = ParallelRangeCount(children.size());
+    std::vector<T> partials(range_count, identity);
+
+    CPPJP::RunParallel(range_count, threads, [&](size_t range)
+    {
+        size_t first = children.size() * range / range_count;
+        size_t last = children.size() * (range + 1) / range_count;
+
+        T partial = identity;
+        for(size_t i = first; i < last; i++)
+            partial = combine(std::move(partial), map(static_cast<const JSONNode&>(*children[i])));
+        partials[range] = std::move(partial);
+    });
+
+    T result = std::move(identity);
+    for(T& partial : partials)
+        result = combine(std::move(result), std::move(partial));
+
+    return result;
 }
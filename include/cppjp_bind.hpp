@@ -0,0 +1,382 @@
+#pragma once
+
+#include <cmath>
+#include <tuple>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <optional>
+#include <charconv>
+#include <string_view>
+#include <type_traits>
+#include "cppjp.hpp"
+
+/*
+    Typed binding between JSON text and C++ structs.
+
+    A struct declares its fields once with CPPJP_BIND, next to the struct and in the same
+    namespace:
+
+        struct Point { double x; double y; std::optional<std::string> label; };
+        CPPJP_BIND(Point, x, y, label)
+
+    CPPJP::Deserialize then fills a Point straight from JSON text without building a JSONNode
+    tree, and CPPJP::Serialize writes it back out. Supported members are bool, integer and
+    floating point types, std::string, std::optional, std::vector and other bound structs.
+*/
+
+namespace CPPJP
+{
+    /**
+     * Sequential reader over JSON text used by the binding templates. Every
+     * read skips leading whitespace. A failed read records the error in
+     * `status()` and returns `false`.
+     */
+    class BindReader
+    {
+        public:
+            BindReader(const char* str, size_t length);
+
+            /**
+             * Consumes `ch` if it is the next character.
+             * @return `true` if `ch` was consumed.
+             */
+            bool consume(char ch);
+
+            /**
+             * Consumes `ch`, failing if it is not the next character.
+             */
+            bool expect(char ch);
+
+            /**
+             * Consumes `null` if it is the next value.
+             * @return `true` if `null` was consumed.
+             */
+            bool readNull();
+
+            bool readBool(bool& value);
+
+            /**
+             * Reads a number and returns its text in `[number_begin, number_end)`.
+             */
+            bool readNumber(const char*& number_begin, const char*& number_end);
+
+            /**
+             * Reads a string, decoding its escape sequences into `out`.
+             */
+            bool readString(std::string& out);
+
+            /**
+             * Reads an object member name and the colon after it. The decoded
+             * name remains valid until the next call to `readKey()`.
+             */
+            bool readKey(std::string_view& key);
+
+            /**
+             * Skips over the next value, checking that it is well formed.
+             */
+            bool skipValue();
+
+            /**
+             * Checks that nothing but whitespace follows the value read.
+             */
+            bool finish();
+
+            /**
+             * Records that the value at the current position does not match
+             * the type it is being read into.
+             * @return Always `false`.
+             */
+            bool mismatch();
+
+            const JSONStatus& status() const { return current_status; }
+
+        private:
+            const char* begin;
+            const char* ch;
+            const char* end;
+            const char* value_start;    // Start of the value being read, for mismatch()
+            size_t depth;               // Nesting of the value being skipped
+            JSONStatus current_status;
+            std::string key_buffer;     // Storage for names with escape sequences
+
+            void skipSpace();
+            bool fail(JSONError error, const char* at);
+            const char* scanString(bool& has_escapes);
+    };
+
+    template<typename S, typename M>
+    struct BindField
+    {
+        const char* name;
+        size_t length;
+        std::uint64_t hash;
+        M S::* member;
+    };
+
+    template<typename T, typename = void>
+    struct IsBound : std::false_type {};
+
+    template<typename T>
+    struct IsBound<T, std::void_t<decltype(CPPJPBindFields(static_cast<const T*>(nullptr)))>> : std::true_type {};
+
+    template<typename T>
+    struct IsVector : std::false_type {};
+
+    template<typename T, typename A>
+    struct IsVector<std::vector<T, A>> : std::true_type {};
+
+    template<typename T>
+    struct IsOptional : std::false_type {};
+
+    template<typename T>
+    struct IsOptional<std::optional<T>> : std::true_type {};
+
+    template<typename T>
+    bool BindRead(BindReader& reader, T& value);
+
+    /*
+        Reads the member value if key names this field.
+        @return ```true``` if the key matched, with ok set to the result of the read.
+    */
+    template<typename T, typename M>
+    bool BindReadField(BindReader& reader, T& value, const BindField<T, M>& field, std::string_view key, std::uint64_t hash, bool& ok)
+    {
+        if(field.hash != hash || field.length != key.size() || memcmp(field.name, key.data(), key.size()) != 0)
+            return false;
+
+        ok = BindRead(reader, value.*field.member);
+        return true;
+    }
+
+    template<typename T>
+    bool BindReadObject(BindReader& reader, T& value)
+    {
+        constexpr auto fields = CPPJPBindFields(static_cast<const T*>(nullptr));
+
+        if(!reader.consume('{')) return reader.mismatch();
+        if(reader.consume('}')) return true;
+
+        do
+        {
+            std::string_view key;
+            if(!reader.readKey(key)) return false;
+
+            // The field hashes are constants, so this unrolls into a chain of integer compares
+            const std::uint64_t hash = HashKey(key.data(), key.size());
+            bool ok = true;
+            bool matched = std::apply([&](const auto&... field)
+            {
+                return (BindReadField(reader, value, field, key, hash, ok) || ...);
+            }, fields);
+
+            if(!ok) return false;
+            if(!matched && !reader.skipValue()) return false;
+        } while(reader.consume(','));
+
+        return reader.expect('}');
+    }
+
+    template<typename T>
+    bool BindRead(BindReader& reader, T& value)
+    {
+        if constexpr(std::is_same_v<T, bool>)
+            return reader.readBool(value);
+        else if constexpr(std::is_arithmetic_v<T>)
+        {
+            const char* number_begin;
+            const char* number_end;
+            if(!reader.readNumber(number_begin, number_end)) return false;
+
+            std::from_chars_result result = std::from_chars(number_begin, number_end, value);
+            if(result.ec != std::errc() || result.ptr != number_end) return reader.mismatch();
+            return true;
+        }
+        else if constexpr(std::is_same_v<T, std::string>)
+            return reader.readString(value);
+        else if constexpr(IsOptional<T>::value)
+        {
+            if(reader.readNull())
+            {
+                value.reset();
+                return true;
+            }
+            return BindRead(reader, value.emplace());
+        }
+        else if constexpr(IsVector<T>::value)
+        {
+            value.clear();
+            if(!reader.consume('[')) return reader.mismatch();
+            if(reader.consume(']')) return true;
+
+            do
+            {
+                typename T::value_type element{};
+                if(!BindRead(reader, element)) return false;
+                value.push_back(std::move(element));
+            } while(reader.consume(','));
+
+            return reader.expect(']');
+        }
+        else
+        {
+            static_assert(IsBound<T>::value, "Type is not bindable, declare its fields with CPPJP_BIND");
+            return BindReadObject(reader, value);
+        }
+    }
+
+    template<typename T>
+    void BindWrite(const T& value, std::string& out)
+    {
+        if constexpr(std::is_same_v<T, bool>)
+            out += value ? "true" : "false";
+        else if constexpr(std::is_arithmetic_v<T>)
+        {
+            if constexpr(std::is_floating_point_v<T>)
+            {
+                // JSON has no representation for infinities and NaN
+                if(!std::isfinite(value))
+                {
+                    out += "null";
+                    return;
+                }
+            }
+
+            char buffer[64];
+            std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+            out.append(buffer, result.ptr - buffer);
+        }
+        else if constexpr(std::is_same_v<T, std::string>)
+        {
+            out += '"';
+            EscapeString(value.data(), value.size(), out);
+            out += '"';
+        }
+        else if constexpr(IsOptional<T>::value)
+        {
+            if(value) BindWrite(*value, out);
+            else out += "null";
+        }
+        else if constexpr(IsVector<T>::value)
+        {
+            out += '[';
+            bool first = true;
+            for(const auto& element : value)
+            {
+                if(!first) out += ',';
+                first = false;
+                BindWrite(static_cast<const typename T::value_type&>(element), out);
+            }
+            out += ']';
+        }
+        else
+        {
+            static_assert(IsBound<T>::value, "Type is not bindable, declare its fields with CPPJP_BIND");
+
+            constexpr auto fields = CPPJPBindFields(static_cast<const T*>(nullptr));
+            bool first = true;
+
+            auto write_field = [&](const auto& field)
+            {
+                out += first ? "\"" : ",\"";
+                first = false;
+                out.append(field.name, field.length);
+                out += "\":";
+                BindWrite(value.*field.member, out);
+            };
+
+            out += '{';
+            std::apply([&](const auto&... field){ (write_field(field), ...); }, fields);
+            out += '}';
+        }
+    }
+
+    /**
+     * Fills a bound value directly from JSON text, without building a tree.
+     * Object members that are not bound are skipped, and bound members
+     * missing from the text keep their current value.
+     * @param str The JSON text to read. Does not need to be null terminated.
+     * @param length The number of bytes in str
+     * @param value The value to fill
+     * @return The result, with the byte offset of the first error. Values
+     * of the wrong type are reported as `JSONError::TYPE_MISMATCH`.
+     */
+    template<typename T>
+    JSONStatus Deserialize(const char* str, size_t length, T& value)
+    {
+        BindReader reader(str, length);
+        if(BindRead(reader, value)) reader.finish();
+        return reader.status();
+    }
+
+    /**
+     * Appends the JSON representation of a bound value to out. Empty
+     * optionals and non-finite floating point numbers are written as null.
+     */
+    template<typename T>
+    void Serialize(const T& value, std::string& out)
+    {
+        BindWrite(value, out);
+    }
+
+    template<typename T>
+    std::string Serialize(const T& value)
+    {
+        std::string out;
+        BindWrite(value, out);
+        return out;
+    }
+}
+
+#define CPPJP_BIND_CAT_(a, b) a##b
+#define CPPJP_BIND_CAT(a, b) CPPJP_BIND_CAT_(a, b)
+
+#define CPPJP_BIND_FIELD(Type, member) \
+    CPPJP::BindField<Type, decltype(Type::member)>{ #member, sizeof(#member) - 1, CPPJP::HashKey(#member, sizeof(#member) - 1), &Type::member }
+
+#define CPPJP_BIND_FIELDS_1(Type, member) CPPJP_BIND_FIELD(Type, member)
+#define CPPJP_BIND_FIELDS_2(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_1(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_3(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_2(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_4(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_3(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_5(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_4(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_6(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_5(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_7(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_6(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_8(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_7(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_9(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_8(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_10(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_9(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_11(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_10(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_12(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_11(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_13(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_12(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_14(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_13(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_15(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_14(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_16(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_15(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_17(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_16(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_18(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_17(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_19(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_18(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_20(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_19(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_21(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_20(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_22(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_21(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_23(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_22(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_24(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_23(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_25(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_24(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_26(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_25(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_27(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_26(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_28(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_27(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_29(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_28(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_30(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_29(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_31(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_30(Type, __VA_ARGS__)
+#define CPPJP_BIND_FIELDS_32(Type, member, ...) CPPJP_BIND_FIELD(Type, member), CPPJP_BIND_FIELDS_31(Type, __VA_ARGS__)
+
+#define CPPJP_BIND_COUNT(...) CPPJP_BIND_COUNT_N(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define CPPJP_BIND_COUNT_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, N, ...) N
+
+/**
+ * Declares the fields of a struct for CPPJP::Deserialize and CPPJP::Serialize.
+ * Must be used at namespace scope in the namespace of the struct. Members are
+ * matched to JSON object names by their identifier, up to 32 per struct.
+ */
+#define CPPJP_BIND(Type, ...) \
+    constexpr auto CPPJPBindFields(const Type*) \
+    { \
+        return std::make_tuple(CPPJP_BIND_CAT(CPPJP_BIND_FIELDS_, CPPJP_BIND_COUNT(__VA_ARGS__))(Type, __VA_ARGS__)); \
+    }
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <functional>
+#include <string_view>
+#include "cppjp.hpp"
+
+/*
+    Pull parsing of documents too large to hold as a tree.
+
+    A JSONCursor steps through the values of a document one at a time. Containers are entered
+    explicitly, and each value inside them is either skipped or read into a small tree of its
+    own, so a document that is one huge array of records can be processed record by record.
+    Input from a file descriptor or stream is read in blocks as the cursor advances and the
+    text before the current value is discarded, so memory is bounded by the largest single
+    value read or skipped, not by the document.
+*/
+
+class JSONCursor
+{
+    public:
+
+    /**
+     * Creates a cursor over `length` bytes of JSON text held in memory. The
+     * text must outlive the cursor.
+     * @param str The JSON text. Does not need to be null terminated.
+     * @param length The number of bytes in `str`.
+     * @param options Limits applied to every value read; `max_depth` also
+     * counts the containers entered around it. `threads` is ignored.
+     */
+    static JSONCursor FromJSONString(const char* str, size_t length, const JSONParseOptions& options = {});
+
+    /**
+     * Creates a cursor reading from a file descriptor as it advances.
+     * @param fd The file descriptor to read from. It is not closed.
+     * @param options As for `FromJSONString()`.
+     */
+    static JSONCursor FromStream(int fd, const JSONParseOptions& options = {});
+
+    /**
+     * Creates a cursor reading from a stream as it advances. The stream must
+     * outlive the cursor.
+     * @param stream The stream to read from.
+     * @param options As for `FromJSONString()`.
+     */
+    static JSONCursor FromStream(std::istream& stream, const JSONParseOptions& options = {});
+
+    JSONCursor(JSONCursor&&) = default;
+    JSONCursor& operator=(JSONCursor&&) = default;
+    JSONCursor(const JSONCursor&) = delete;
+    JSONCursor& operator=(const JSONCursor&) = delete;
+
+    /**
+     * Moves to the next value: the document itself on the first call, then
+     * the next element or member of the innermost entered container. A value
+     * that was not read, skipped or entered is skipped first.
+     * @return `true` if the cursor is on a value. `false` at the end of the
+     * document, or at the end of a container, which is then left so the next
+     * call continues in the container around it. Also `false` on error, which
+     * `status()` reports.
+     */
+    bool next();
+
+    /**
+     * Enters the current value, which must be an array, so that `next()`
+     * steps through its elements.
+     * @return `false` if entering it exceeds `max_depth`.
+     * @throws json::invalid_node_type if the current value is not an array.
+     * @throws json::bad_node_access if the cursor is not on a value.
+     */
+    bool enterArray();
+
+    /**
+     * Enters the current value, which must be an object, so that `next()`
+     * steps through its members and `name()` gives their names.
+     * @return `false` if entering it exceeds `max_depth`.
+     * @throws json::invalid_node_type if the current value is not an object.
+     * @throws json::bad_node_access if the cursor is not on a value.
+     */
+    bool enterObject();
+
+    /**
+     * Steps over the current value, checking its text like `JSON::Validate()`
+     * with the cursor's options, without building a tree. UTF-8 is checked
+     * only if `validate_utf8` is set, as when reading.
+     * @return `false` if the value is not valid JSON.
+     * @throws json::bad_node_access if the cursor is not on a value.
+     */
+    bool skipValue();
+
+    /**
+     * Parses the current value, and only it, into a tree of its own.
+     * @return An owning JSON object, or an invalid object if the value does
+     * not parse.
+     * @throws json::bad_node_access if the cursor is not on a value.
+     */
+    JSON readValue();
+
+    /**
+     * The type of the current value, known without reading it.
+     */
+    JSONNodeType type() const { return current_type; }
+
+    /**
+     * The unescaped name of the current value inside an object, empty
+     * elsewhere.
+     */
+    std::string_view name() const { return member_name; }
+
+    /**
+     * The number of containers entered and not yet left.
+     */
+    size_t depth() const { return containers.size(); }
+
+    /**
+     * The first error encountered, with its byte offset in the document. Once
+     * set, every further step fails.
+     */
+    const JSONStatus& status() const { return error; }
+
+    private:
+
+    JSONCursor() = default;
+
+    std::function<long(char*, size_t)> read;    // Empty when the whole text is in memory
+    const char* text = nullptr;                 // Text held in memory, nullptr when reading
+    std::string buffer;                         // Input read and not yet discarded
+    size_t length = 0;                          // Bytes available from data()
+    size_t position = 0;                        // Next byte to look at, from data()
+    size_t base_offset = 0;                     // Document offset of data()
+    bool input_ended = false;
+    bool read_failed = false;
+
+    JSONParseOptions options;
+    JSONStatus error;
+    std::vector<char> containers;               // Closing bracket of every entered container
+    bool started = false;                       // The document value has been reached
+    bool first_member = false;                  // Nothing was read yet in the innermost container
+    bool value_pending = false;                 // The cursor is on a value that was not consumed
+    JSONNodeType current_type = JSONNodeType::JNULL;
+    std::string member_name;
+
+    const char* data() const { return text ? text : buffer.data(); }
+
+    bool fill();
+    bool skipSpace();
+    bool fail(JSONError error_code, size_t at);
+    bool failAtEnd();
+    bool beginValue();
+    bool readName();
+    bool enter(JSONNodeType type, char closing);
+    bool scanValue(size_t& value_length);
+    bool takeValue(size_t& value_length);
+};
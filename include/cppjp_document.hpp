@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "cppjp.hpp"
+
+/*
+    JSON text kept in sync with its parsed tree.
+
+    Every node records where it was found in the text. An edit to the text re-parses only the
+    smallest value that encloses it, normally the innermost array or object around it, splices
+    the result into the existing tree and shifts the recorded positions of the values after
+    it. Positions are stored relative to the previous sibling, so only the nodes along the
+    path to the edit are touched. Finding that path would mean walking every sibling before it,
+    so containers with many children also record every 64th child with its position, built on
+    the first edit or span lookup that reaches them. After that an edit costs a binary search
+    and a walk of at most 64 siblings per level, plus the value re-parsed, and a span lookup a
+    scan of the recorded children. Removing a child drops the records of its container.
+*/
+
+/**
+ * Position of a value in the source text.
+ */
+struct JSONSpan
+{
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+class JSONDocument
+{
+    public:
+
+    /**
+     * Parses `text` and keeps it together with the tree.
+     * @param text The JSON text.
+     * @param options Options controlling the parse. `track_source` is
+     * always enabled.
+     * @param status If not null, receives the error and its byte offset when
+     * parsing fails.
+     * @return The document. Its tree is invalid if the text did not parse.
+     */
+    static JSONDocument Parse(std::string text, const JSONParseOptions& options = {}, JSONStatus* status = nullptr);
+
+    /**
+     * Replaces `length` bytes of the text at `offset` with `replacement` and
+     * updates the tree. Nodes outside the re-parsed value, and `JSON`
+     * objects wrapping them, stay valid.
+     * @param offset Start of the replaced range.
+     * @param length Number of bytes replaced.
+     * @param replacement The new text of the range.
+     * @param status If not null, receives the error and its byte offset when
+     * the edited text does not parse.
+     * @return `true` if the edited text parsed; otherwise the tree is invalid
+     * until a later edit makes the text valid again.
+     * @throws std::out_of_range if the range is outside the text.
+     */
+    bool edit(size_t offset, size_t length, std::string_view replacement, JSONStatus* status = nullptr);
+
+    /**
+     * Finds where a value of this document is in the text. The first lookup
+     * in a large container walks all of its children once.
+     * @param value A node of this document's tree.
+     * @return The offset and length of its text.
+     */
+    JSONSpan spanOf(const JSONNode* value) const;
+
+    const std::string& text() const { return source; }
+    JSON& root() { return tree; }
+    bool isValid() const { return tree.isValid(); }
+
+    private:
+
+    JSONDocument();
+
+    std::string source;
+    JSON tree;
+    JSONParseOptions options;
+
+    bool parseAll(JSONStatus* status);
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "cppjp.hpp"
+
+/*
+    Validation of JSON trees against a JSON Schema subset.
+
+    JSONSchema::Compile turns a schema document into a flat program: one run of checks per
+    sub-schema and a hashed property table per object schema. Validation then walks the tree
+    once, without recursion and without allocating per value.
+
+    Supported keywords: type (including "integer"), enum, const, minimum, maximum,
+    exclusiveMinimum, exclusiveMaximum, minLength, maxLength, minItems, maxItems, items,
+    minProperties, maxProperties, properties, required and additionalProperties. Annotations
+    such as title and description are ignored; keywords that would change the outcome but are
+    not supported, such as $ref or anyOf, are rejected when compiling.
+*/
+
+/**
+ * The outcome of validating a document against a `JSONSchema`.
+ */
+struct JSONSchemaResult
+{
+    /**
+     * JSON Pointer to the first value that failed, empty for the root
+     * or on success. Path segments use object names with their JSON
+     * escapes decoded.
+     */
+    std::string path;
+
+    /**
+     * The schema keyword that failed, or `nullptr` on success.
+     */
+    const char* keyword = nullptr;
+
+    bool ok() const { return keyword == nullptr; }
+    explicit operator bool() const { return ok(); }
+};
+
+class JSONSchema
+{
+    public:
+
+    /**
+     * Compiles a schema document.
+     * @param schema The schema, an object or a boolean.
+     * @return The compiled schema, independent of `schema` once compiled.
+     * @throws json::invalid_schema if the schema is malformed or uses an
+     * unsupported keyword.
+     */
+    static JSONSchema Compile(JSON& schema);
+
+    /**
+     * Validates a document in one pass, stopping at the first violation
+     * in document order.
+     * @param document The document to validate.
+     * @return The result, with the path of the first violation.
+     */
+    JSONSchemaResult validate(JSON& document) const;
+
+    /**
+     * Validates the tree under `node`.
+     * @param node The root of the tree to validate.
+     * @return The result, with the path relative to `node`.
+     */
+    JSONSchemaResult validate(JSONNode* node) const;
+
+    private:
+
+    enum class SchemaOp : std::uint8_t
+    {
+        TYPE,               // operand: mask of accepted types
+        ENUM,               // operand: first constant, count: number of constants
+        MINIMUM,
+        MAXIMUM,
+        EXCLUSIVE_MINIMUM,
+        EXCLUSIVE_MAXIMUM,
+        MIN_LENGTH,
+        MAX_LENGTH,
+        MIN_ITEMS,
+        MAX_ITEMS,
+        MIN_PROPERTIES,
+        MAX_PROPERTIES,
+        ITEMS,              // operand: schema of every element
+        PROPERTIES,         // operand: index of the object table
+        REJECT              // The false schema
+    };
+
+    struct SchemaCheck
+    {
+        SchemaOp op;
+        std::uint32_t operand = 0;
+        std::uint32_t count = 0;
+        double limit = 0;
+        const char* keyword;
+    };
+
+    // A compiled schema is the run of checks [first_check, first_check + check_count)
+    struct SchemaProgram
+    {
+        std::uint32_t first_check = 0;
+        std::uint32_t check_count = 0;
+    };
+
+    struct SchemaProperty
+    {
+        std::string name;
+        std::uint64_t hash;
+        std::uint32_t schema;       // no_schema if the property is only required
+        std::uint32_t required;     // Index among the required properties, or no_schema
+    };
+
+    struct SchemaObject
+    {
+        std::uint32_t first_property = 0;
+        std::uint32_t property_count = 0;
+        std::uint32_t required_count = 0;
+        std::uint32_t additional;   // Schema for other members, or no_schema if any member is allowed
+        bool additional_allowed = true;
+    };
+
+    static const std::uint32_t no_schema = UINT32_MAX;
+
+    std::vector<SchemaProgram> programs;
+    std::vector<SchemaCheck> checks;
+    std::vector<SchemaObject> objects;
+    std::vector<SchemaProperty> properties;     // Sorted by hash within each object
+    std::vector<JSON> constants;                // Owning copies of enum and const values
+
+    std::uint32_t compile(JSONNode* schema);
+    const SchemaProperty* findProperty(const SchemaObject& object, const JSONNode* member) const;
+};
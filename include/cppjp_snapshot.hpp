@@ -0,0 +1,101 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "cppjp.hpp"
+
+/*
+    Atomic publication of read-mostly documents.
+
+    A JSONSnapshot holds the current version of a document that many threads read while
+    another thread occasionally replaces it. Readers pin the current version with a single
+    atomic increment and unpin it with a single atomic decrement, so reads never block or
+    retry, not even while a new version is being published. A replaced version is freed by
+    whichever thread lets go of it last.
+
+    The reference count is split in two. The current version's slot index and the number of
+    pins taken on it share one 64 bit word, so a pin is one fetch_add. Unpins are counted
+    against the slot itself. When a version is replaced, the publisher moves the pins taken
+    on it over to the slot, and the count reaching zero on either side frees the version.
+*/
+
+class JSONSnapshot
+{
+    private:
+
+    struct Slot
+    {
+        JSON document = JSON::Adopt(nullptr);
+        std::atomic<std::int64_t> balance{ 0 };    // Pins handed over by the publisher minus unpins
+        std::atomic<bool> in_use{ false };
+
+        void unpin();
+    };
+
+    public:
+
+    /**
+     * A reader's handle on one version of the document. The version stays
+     * alive, unchanged, until the pin is destroyed.
+     */
+    class Pin
+    {
+        public:
+            Pin(Pin&& other) noexcept;
+            Pin& operator=(Pin&& other) noexcept;
+            Pin(const Pin&) = delete;
+            Pin& operator=(const Pin&) = delete;
+            ~Pin();
+
+            /**
+             * The pinned document, invalid if nothing was published yet.
+             * It is shared with other readers and must not be modified.
+             */
+            JSON& operator*() { return view; }
+            JSON* operator->() { return &view; }
+
+        private:
+            friend class JSONSnapshot;
+            Pin(Slot* slot, JSONNode* root);
+
+            Slot* slot;
+            JSON view;
+    };
+
+    JSONSnapshot();
+    JSONSnapshot(const JSONSnapshot&) = delete;
+    JSONSnapshot& operator=(const JSONSnapshot&) = delete;
+
+    /**
+     * Frees the current version. No pins may be outstanding.
+     */
+    ~JSONSnapshot();
+
+    /**
+     * Replaces the current version with `document`. Strings are decoded,
+     * numbers formatted and hashes computed first, so readers never write
+     * to the tree. Readers that pinned the previous version keep it until
+     * they let go. Publishers are serialised with each other but never
+     * wait for readers, unless every slot is held by an old version.
+     * @param document An owning document, taken over by the snapshot.
+     */
+    void publish(JSON&& document);
+
+    /**
+     * Pins the current version. Wait-free.
+     * @return A pin on the current version.
+     */
+    Pin pin() const;
+
+    private:
+
+    // Slot index in the top 8 bits, pins taken on that slot in the rest
+    static const int index_shift = 56;
+    static const std::uint64_t count_mask = (std::uint64_t{ 1 } << index_shift) - 1;
+    static const size_t slot_count = 256;
+
+    mutable Slot slots[slot_count];
+    mutable std::atomic<std::uint64_t> current{ 0 };
+    std::mutex publish_mutex;
+};
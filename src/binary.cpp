@@ -0,0 +1,1060 @@
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <vector>
+#include <charconv>
+#include <stdexcept>
+#include "cppjp.hpp"
+#include "standalone.hpp"
+#include "scan.hpp"
+#include "utf8.hpp"
+#include "exceptions.hpp"
+
+/*
+    MessagePack and CBOR conversion of JSON trees.
+
+    The encoders walk the tree once, writing every value with the shortest header that holds
+    its length, and copy string contents straight from the nodes. Numbers are written as
+    integers or floats when that binary form converts back to exactly the text they were
+    parsed from. Any other number text, such as "2.50", "1E5" or an integer beyond 64 bits, is
+    carried as text: in MessagePack extension type 1, and in CBOR under tag 262 (embedded
+    JSON). Decoding therefore always reproduces the original document.
+
+    The decoders turn the input into a stream of items and build the tree from them without
+    recursion, so hostile nesting can not overflow the stack. The limits of JSONParseOptions
+    apply as they do to parsing text.
+*/
+
+namespace
+{
+    const std::int8_t message_pack_number_ext = 1;
+    const std::uint64_t cbor_embedded_json_tag = 262;
+
+    //
+    //  Encoding
+    //
+
+    void PutByte(std::string& out, std::uint8_t byte) { out += static_cast<char>(byte); }
+
+    template<typename T>
+    void PutBigEndian(std::string& out, T value)
+    {
+        char bytes[sizeof(T)];
+        for(size_t i = 0; i < sizeof(T); i++)
+            bytes[i] = static_cast<char>(value >> (8 * (sizeof(T) - 1 - i)));
+        out.append(bytes, sizeof(T));
+    }
+
+    std::uint32_t FloatBits(float value)
+    {
+        std::uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    std::uint64_t DoubleBits(double value)
+    {
+        std::uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // Whether a double survives a round trip through a float
+    bool FitsFloat(double value)
+    {
+        return std::fabs(value) <= FLT_MAX && static_cast<double>(static_cast<float>(value)) == value;
+    }
+
+    enum class NumberForm { INT64, UINT64, DOUBLE, TEXT };
+
+    struct BinaryNumber
+    {
+        NumberForm form;
+        JSONNumber value;
+    };
+
+    /*
+        Parses the whole of text as T and checks that formatting the value gives text back.
+    */
+    template<typename T>
+    bool ParsesBackTo(const std::string& text, T& value)
+    {
+        const char* end = text.data() + text.size();
+        std::from_chars_result result = std::from_chars(text.data(), end, value);
+        if(result.ec != std::errc() || result.ptr != end) return false;
+
+        char buffer[max_number_text];
+        char* buffer_end = std::to_chars(buffer, buffer + max_number_text, value).ptr;
+        return static_cast<size_t>(buffer_end - buffer) == text.size() && memcmp(buffer, text.data(), text.size()) == 0;
+    }
+
+    /*
+        Finds the binary form a number can be encoded in without changing its text.
+    */
+    BinaryNumber ClassifyNumber(const JSONNode* node)
+    {
+        BinaryNumber number{ NumberForm::TEXT, node->number };
+
+        if(node->flags & NODE_INT64) number.form = NumberForm::INT64;
+        else if(node->flags & NODE_UINT64) number.form = NumberForm::UINT64;
+        else if(node->flags & NODE_DOUBLE) number.form = NumberForm::DOUBLE;
+        else if(ParsesBackTo(node->string_data, number.value.int64)) number.form = NumberForm::INT64;
+        else if(ParsesBackTo(node->string_data, number.value.uint64)) number.form = NumberForm::UINT64;
+        else if(ParsesBackTo(node->string_data, number.value.real)) number.form = NumberForm::DOUBLE;
+
+        return number;
+    }
+
+    size_t CountChildren(const JSONNode* node)
+    {
+        size_t count = 0;
+        for(const JSONNode* child = node->child; child; child = child->next) count++;
+        return count;
+    }
+
+    /*
+        Writes root and its descendants in pre-order through writer, member names before their
+        values.
+    */
+    template<typename Writer>
+    void Encode(JSONNode* root, Writer& writer)
+    {
+        JSONNode* node = root;
+
+        while(node)
+        {
+            if(node != root && node->parent->type == JSONNodeType::OBJECT)
+                writer.string(node->name);
+
+            switch(node->type)
+            {
+                case JSONNodeType::STRING:  writer.string(DecodedString(node)); break;
+                case JSONNodeType::NUMBER:  writer.number(ClassifyNumber(node), node->string_data); break;
+                case JSONNodeType::TRUE:    writer.boolean(true); break;
+                case JSONNodeType::FALSE:   writer.boolean(false); break;
+                case JSONNodeType::JNULL:   writer.null(); break;
+                case JSONNodeType::ARRAY:   writer.array(CountChildren(node)); break;
+                case JSONNodeType::OBJECT:  writer.map(CountChildren(node)); break;
+            }
+
+            if(node->child)
+            {
+                node = node->child;
+                continue;
+            }
+
+            while(node != root && !node->next)
+                node = node->parent;
+
+            node = node == root ? nullptr : node->next;
+        }
+    }
+
+    class MessagePackWriter
+    {
+        public:
+            explicit MessagePackWriter(std::string& out) : out(out) {}
+
+            void null() { PutByte(out, 0xC0); }
+            void boolean(bool value) { PutByte(out, value ? 0xC3 : 0xC2); }
+
+            void string(std::string_view text)
+            {
+                size_t length = text.size();
+
+                if(length < 32) PutByte(out, 0xA0 | length);
+                else if(length <= UINT8_MAX)
+                {
+                    PutByte(out, 0xD9);
+                    PutByte(out, length);
+                }
+                else if(length <= UINT16_MAX)
+                {
+                    PutByte(out, 0xDA);
+                    PutBigEndian<std::uint16_t>(out, length);
+                }
+                else
+                {
+                    PutByte(out, 0xDB);
+                    PutBigEndian<std::uint32_t>(out, CheckedLength(length));
+                }
+
+                out.append(text);
+            }
+
+            void array(size_t count) { container(count, 0x90, 0xDC); }
+            void map(size_t count) { container(count, 0x80, 0xDE); }
+
+            void number(const BinaryNumber& number, const std::string& text)
+            {
+                switch(number.form)
+                {
+                    case NumberForm::INT64:
+                        if(number.value.int64 >= 0) unsignedInteger(number.value.int64);
+                        else signedInteger(number.value.int64);
+                        break;
+
+                    case NumberForm::UINT64:
+                        unsignedInteger(number.value.uint64);
+                        break;
+
+                    case NumberForm::DOUBLE:
+                        if(FitsFloat(number.value.real))
+                        {
+                            PutByte(out, 0xCA);
+                            PutBigEndian(out, FloatBits(static_cast<float>(number.value.real)));
+                        }
+                        else
+                        {
+                            PutByte(out, 0xCB);
+                            PutBigEndian(out, DoubleBits(number.value.real));
+                        }
+                        break;
+
+                    case NumberForm::TEXT:
+                        numberText(text);
+                        break;
+                }
+            }
+
+        private:
+            std::string& out;
+
+            static std::uint32_t CheckedLength(size_t length)
+            {
+                if(length > UINT32_MAX) throw std::length_error("MessagePack can not encode more than 2^32 - 1 bytes or entries");
+                return static_cast<std::uint32_t>(length);
+            }
+
+            // Headers of arrays and maps, fix_header holding counts below 16 and wide_header 16 bit counts
+            void container(size_t count, std::uint8_t fix_header, std::uint8_t wide_header)
+            {
+                if(count < 16) PutByte(out, fix_header | count);
+                else if(count <= UINT16_MAX)
+                {
+                    PutByte(out, wide_header);
+                    PutBigEndian<std::uint16_t>(out, count);
+                }
+                else
+                {
+                    PutByte(out, wide_header + 1);
+                    PutBigEndian<std::uint32_t>(out, CheckedLength(count));
+                }
+            }
+
+            void unsignedInteger(std::uint64_t value)
+            {
+                if(value <= 0x7F) PutByte(out, value);
+                else if(value <= UINT8_MAX)
+                {
+                    PutByte(out, 0xCC);
+                    PutByte(out, value);
+                }
+                else if(value <= UINT16_MAX)
+                {
+                    PutByte(out, 0xCD);
+                    PutBigEndian<std::uint16_t>(out, value);
+                }
+                else if(value <= UINT32_MAX)
+                {
+                    PutByte(out, 0xCE);
+                    PutBigEndian<std::uint32_t>(out, value);
+                }
+                else
+                {
+                    PutByte(out, 0xCF);
+                    PutBigEndian<std::uint64_t>(out, value);
+                }
+            }
+
+            void signedInteger(std::int64_t value)
+            {
+                if(value >= -32) PutByte(out, static_cast<std::uint8_t>(value));
+                else if(value >= INT8_MIN)
+                {
+                    PutByte(out, 0xD0);
+                    PutByte(out, static_cast<std::uint8_t>(value));
+                }
+                else if(value >= INT16_MIN)
+                {
+                    PutByte(out, 0xD1);
+                    PutBigEndian(out, static_cast<std::uint16_t>(value));
+                }
+                else if(value >= INT32_MIN)
+                {
+                    PutByte(out, 0xD2);
+                    PutBigEndian(out, static_cast<std::uint32_t>(value));
+                }
+                else
+                {
+                    PutByte(out, 0xD3);
+                    PutBigEndian(out, static_cast<std::uint64_t>(value));
+                }
+            }
+
+            void numberText(const std::string& text)
+            {
+                size_t length = text.size();
+
+                switch(length)
+                {
+                    case 1:  PutByte(out, 0xD4); break;
+                    case 2:  PutByte(out, 0xD5); break;
+                    case 4:  PutByte(out, 0xD6); break;
+                    case 8:  PutByte(out, 0xD7); break;
+                    case 16: PutByte(out, 0xD8); break;
+
+                    default:
+                        if(length <= UINT8_MAX)
+                        {
+                            PutByte(out, 0xC7);
+                            PutByte(out, length);
+                        }
+                        else if(length <= UINT16_MAX)
+                        {
+                            PutByte(out, 0xC8);
+                            PutBigEndian<std::uint16_t>(out, length);
+                        }
+                        else
+                        {
+                            PutByte(out, 0xC9);
+                            PutBigEndian<std::uint32_t>(out, CheckedLength(length));
+                        }
+                }
+
+                PutByte(out, message_pack_number_ext);
+                out += text;
+            }
+    };
+
+    class CBORWriter
+    {
+        public:
+            explicit CBORWriter(std::string& out) : out(out) {}
+
+            void null() { PutByte(out, 0xF6); }
+            void boolean(bool value) { PutByte(out, value ? 0xF5 : 0xF4); }
+
+            void string(std::string_view text)
+            {
+                head(3, text.size());
+                out.append(text);
+            }
+
+            void array(size_t count) { head(4, count); }
+            void map(size_t count) { head(5, count); }
+
+            void number(const BinaryNumber& number, const std::string& text)
+            {
+                switch(number.form)
+                {
+                    case NumberForm::INT64:
+                        // Negative integers are stored as -1 - n
+                        if(number.value.int64 >= 0) head(0, number.value.int64);
+                        else head(1, ~static_cast<std::uint64_t>(number.value.int64));
+                        break;
+
+                    case NumberForm::UINT64:
+                        head(0, number.value.uint64);
+                        break;
+
+                    case NumberForm::DOUBLE:
+                        if(FitsFloat(number.value.real))
+                        {
+                            PutByte(out, 0xFA);
+                            PutBigEndian(out, FloatBits(static_cast<float>(number.value.real)));
+                        }
+                        else
+                        {
+                            PutByte(out, 0xFB);
+                            PutBigEndian(out, DoubleBits(number.value.real));
+                        }
+                        break;
+
+                    case NumberForm::TEXT:
+                        head(6, cbor_embedded_json_tag);
+                        head(2, text.size());
+                        out += text;
+                        break;
+                }
+            }
+
+        private:
+            std::string& out;
+
+            // The initial byte of a data item and its argument
+            void head(std::uint8_t major, std::uint64_t value)
+            {
+                major <<= 5;
+
+                if(value < 24) PutByte(out, major | value);
+                else if(value <= UINT8_MAX)
+                {
+                    PutByte(out, major | 24);
+                    PutByte(out, value);
+                }
+                else if(value <= UINT16_MAX)
+                {
+                    PutByte(out, major | 25);
+                    PutBigEndian<std::uint16_t>(out, value);
+                }
+                else if(value <= UINT32_MAX)
+                {
+                    PutByte(out, major | 26);
+                    PutBigEndian<std::uint32_t>(out, value);
+                }
+                else
+                {
+                    PutByte(out, major | 27);
+                    PutBigEndian<std::uint64_t>(out, value);
+                }
+            }
+    };
+
+    //
+    //  Decoding
+    //
+
+    enum class ItemKind { JNULL, TRUE, FALSE, INT64, UINT64, DOUBLE, NUMBER_TEXT, STRING, ARRAY, MAP, BREAK };
+
+    /*
+        One value, or the header of an array or map, read from the input.
+    */
+    struct Item
+    {
+        ItemKind kind = ItemKind::JNULL;
+        JSONNumber number = {};
+        std::string_view text;      // Contents of a STRING or NUMBER_TEXT, valid until the next read
+        std::uint64_t count = 0;    // Entries of a definite length ARRAY or MAP
+        bool indefinite = false;    // The ARRAY or MAP ends at a BREAK item instead
+        const char* at = nullptr;   // Start of the item in the input
+    };
+
+    /*
+        Input cursor shared by the readers.
+    */
+    class Input
+    {
+        public:
+            Input(const char* begin, const char* end) : begin(begin), ch(begin), end(end) {}
+
+            size_t remaining() const { return end - ch; }
+            bool atEnd() const { return ch == end; }
+
+            bool fail(JSONStatus& status, JSONError error, const char* at) const
+            {
+                status = JSONStatus{ error, static_cast<size_t>(at - begin) };
+                return false;
+            }
+
+        protected:
+            const char* begin;
+            const char* ch;
+            const char* end;
+
+            template<typename T>
+            bool takeBigEndian(T& value)
+            {
+                if(remaining() < sizeof(T)) return false;
+
+                value = 0;
+                for(size_t i = 0; i < sizeof(T); i++)
+                    value = static_cast<T>(value << 8) | static_cast<unsigned char>(ch[i]);
+
+                ch += sizeof(T);
+                return true;
+            }
+
+            bool takeBytes(std::uint64_t length, std::string_view& bytes)
+            {
+                if(remaining() < length) return false;
+
+                bytes = std::string_view(ch, length);
+                ch += length;
+                return true;
+            }
+
+            static void SetUnsigned(Item& item, std::uint64_t value)
+            {
+                if(value <= INT64_MAX)
+                {
+                    item.kind = ItemKind::INT64;
+                    item.number.int64 = static_cast<std::int64_t>(value);
+                }
+                else
+                {
+                    item.kind = ItemKind::UINT64;
+                    item.number.uint64 = value;
+                }
+            }
+
+            static void SetDouble(Item& item, double value)
+            {
+                item.kind = ItemKind::DOUBLE;
+                item.number.real = value;
+            }
+    };
+
+    class MessagePackReader : public Input
+    {
+        public:
+            using Input::Input;
+
+            bool read(Item& item, JSONStatus& status);
+
+        private:
+            bool readString(Item& item, std::uint64_t length, JSONStatus& status)
+            {
+                item.kind = ItemKind::STRING;
+                if(!takeBytes(length, item.text)) return fail(status, JSONError::UNEXPECTED_END, end);
+                return true;
+            }
+
+            bool readExt(Item& item, std::uint64_t length, JSONStatus& status)
+            {
+                std::uint8_t type;
+                if(!takeBigEndian(type) || !takeBytes(length, item.text)) return fail(status, JSONError::UNEXPECTED_END, end);
+                if(static_cast<std::int8_t>(type) != message_pack_number_ext) return fail(status, JSONError::INVALID_ENCODING, item.at);
+
+                item.kind = ItemKind::NUMBER_TEXT;
+                return true;
+            }
+
+            void setContainer(Item& item, ItemKind kind, std::uint64_t count)
+            {
+                item.kind = kind;
+                item.count = count;
+            }
+    };
+
+    bool MessagePackReader::read(Item& item, JSONStatus& status)
+    {
+        item = Item{};
+        item.at = ch;
+        if(ch == end) return fail(status, JSONError::UNEXPECTED_END, ch);
+
+        std::uint8_t byte = static_cast<unsigned char>(*ch++);
+
+        if(byte <= 0x7F)
+        {
+            SetUnsigned(item, byte);
+            return true;
+        }
+        if(byte >= 0xE0)
+        {
+            item.kind = ItemKind::INT64;
+            item.number.int64 = static_cast<std::int8_t>(byte);
+            return true;
+        }
+        if(byte <= 0x8F)
+        {
+            setContainer(item, ItemKind::MAP, byte & 0x0F);
+            return true;
+        }
+        if(byte <= 0x9F)
+        {
+            setContainer(item, ItemKind::ARRAY, byte & 0x0F);
+            return true;
+        }
+        if(byte <= 0xBF) return readString(item, byte & 0x1F, status);
+
+        std::uint8_t u8;
+        std::uint16_t u16;
+        std::uint32_t u32;
+        std::uint64_t u64;
+
+        switch(byte)
+        {
+            case 0xC0: item.kind = ItemKind::JNULL; return true;
+            case 0xC2: item.kind = ItemKind::FALSE; return true;
+            case 0xC3: item.kind = ItemKind::TRUE; return true;
+
+            case 0xCA:
+            {
+                if(!takeBigEndian(u32)) break;
+                float value;
+                memcpy(&value, &u32, sizeof(value));
+                SetDouble(item, value);
+                return true;
+            }
+
+            case 0xCB:
+            {
+                if(!takeBigEndian(u64)) break;
+                double value;
+                memcpy(&value, &u64, sizeof(value));
+                SetDouble(item, value);
+                return true;
+            }
+
+            case 0xCC: if(!takeBigEndian(u8)) break; SetUnsigned(item, u8); return true;
+            case 0xCD: if(!takeBigEndian(u16)) break; SetUnsigned(item, u16); return true;
+            case 0xCE: if(!takeBigEndian(u32)) break; SetUnsigned(item, u32); return true;
+            case 0xCF: if(!takeBigEndian(u64)) break; SetUnsigned(item, u64); return true;
+
+            case 0xD0: if(!takeBigEndian(u8)) break; item.kind = ItemKind::INT64; item.number.int64 = static_cast<std::int8_t>(u8); return true;
+            case 0xD1: if(!takeBigEndian(u16)) break; item.kind = ItemKind::INT64; item.number.int64 = static_cast<std::int16_t>(u16); return true;
+            case 0xD2: if(!takeBigEndian(u32)) break; item.kind = ItemKind::INT64; item.number.int64 = static_cast<std::int32_t>(u32); return true;
+            case 0xD3: if(!takeBigEndian(u64)) break; item.kind = ItemKind::INT64; item.number.int64 = static_cast<std::int64_t>(u64); return true;
+
+            case 0xD4: return readExt(item, 1, status);
+            case 0xD5: return readExt(item, 2, status);
+            case 0xD6: return readExt(item, 4, status);
+            case 0xD7: return readExt(item, 8, status);
+            case 0xD8: return readExt(item, 16, status);
+            case 0xC7: if(!takeBigEndian(u8)) break; return readExt(item, u8, status);
+            case 0xC8: if(!takeBigEndian(u16)) break; return readExt(item, u16, status);
+            case 0xC9: if(!takeBigEndian(u32)) break; return readExt(item, u32, status);
+
+            case 0xD9: if(!takeBigEndian(u8)) break; return readString(item, u8, status);
+            case 0xDA: if(!takeBigEndian(u16)) break; return readString(item, u16, status);
+            case 0xDB: if(!takeBigEndian(u32)) break; return readString(item, u32, status);
+
+            case 0xDC: if(!takeBigEndian(u16)) break; setContainer(item, ItemKind::ARRAY, u16); return true;
+            case 0xDD: if(!takeBigEndian(u32)) break; setContainer(item, ItemKind::ARRAY, u32); return true;
+            case 0xDE: if(!takeBigEndian(u16)) break; setContainer(item, ItemKind::MAP, u16); return true;
+            case 0xDF: if(!takeBigEndian(u32)) break; setContainer(item, ItemKind::MAP, u32); return true;
+
+            default:
+                // Binary data has no JSON equivalent, 0xC1 is never used
+                return fail(status, JSONError::INVALID_ENCODING, item.at);
+        }
+
+        return fail(status, JSONError::UNEXPECTED_END, end);
+    }
+
+    double HalfToDouble(std::uint16_t half)
+    {
+        int exponent = (half >> 10) & 0x1F;
+        int mantissa = half & 0x3FF;
+
+        double value;
+        if(exponent == 0) value = std::ldexp(mantissa, -24);
+        else if(exponent != 31) value = std::ldexp(mantissa + 1024, exponent - 25);
+        else value = mantissa == 0 ? HUGE_VAL : NAN;
+
+        return (half & 0x8000) ? -value : value;
+    }
+
+    class CBORReader : public Input
+    {
+        public:
+            using Input::Input;
+
+            bool read(Item& item, JSONStatus& status);
+
+        private:
+            std::string scratch;    // Joined chunks of indefinite length strings and formatted numbers
+
+            /*
+                Reads the argument of a head whose additional information is info.
+                @return ```false``` at the end of the input.
+            */
+            bool argument(std::uint8_t info, std::uint64_t& value)
+            {
+                std::uint8_t u8;
+                std::uint16_t u16;
+                std::uint32_t u32;
+
+                switch(info)
+                {
+                    case 24: if(!takeBigEndian(u8)) return false; value = u8; return true;
+                    case 25: if(!takeBigEndian(u16)) return false; value = u16; return true;
+                    case 26: if(!takeBigEndian(u32)) return false; value = u32; return true;
+                    case 27: return takeBigEndian(value);
+                    default: value = info; return true;
+                }
+            }
+
+            bool readChunks(Item& item, JSONStatus& status);
+            bool readSimple(Item& item, std::uint8_t info, JSONStatus& status);
+    };
+
+    /*
+        Joins the chunks of an indefinite length text string.
+    */
+    bool CBORReader::readChunks(Item& item, JSONStatus& status)
+    {
+        scratch.clear();
+
+        while(true)
+        {
+            if(ch == end) return fail(status, JSONError::UNEXPECTED_END, ch);
+
+            const char* chunk_at = ch;
+            std::uint8_t byte = static_cast<unsigned char>(*ch++);
+            if(byte == 0xFF) break;
+
+            std::uint64_t length;
+            std::string_view chunk;
+            if(byte >> 5 != 3 || (byte & 0x1F) > 27) return fail(status, JSONError::INVALID_ENCODING, chunk_at);
+            if(!argument(byte & 0x1F, length) || !takeBytes(length, chunk)) return fail(status, JSONError::UNEXPECTED_END, end);
+
+            scratch += chunk;
+        }
+
+        item.kind = ItemKind::STRING;
+        item.text = scratch;
+        return true;
+    }
+
+    bool CBORReader::readSimple(Item& item, std::uint8_t info, JSONStatus& status)
+    {
+        std::uint16_t u16;
+        std::uint32_t u32;
+        std::uint64_t u64;
+
+        switch(info)
+        {
+            case 20: item.kind = ItemKind::FALSE; return true;
+            case 21: item.kind = ItemKind::TRUE; return true;
+            case 22: case 23: item.kind = ItemKind::JNULL; return true; // null and undefined
+            case 31: item.kind = ItemKind::BREAK; return true;
+
+            case 25:
+                if(!takeBigEndian(u16)) break;
+                SetDouble(item, HalfToDouble(u16));
+                return true;
+
+            case 26:
+            {
+                if(!takeBigEndian(u32)) break;
+                float value;
+                memcpy(&value, &u32, sizeof(value));
+                SetDouble(item, value);
+                return true;
+            }
+
+            case 27:
+            {
+                if(!takeBigEndian(u64)) break;
+                double value;
+                memcpy(&value, &u64, sizeof(value));
+                SetDouble(item, value);
+                return true;
+            }
+
+            default:
+                return fail(status, JSONError::INVALID_ENCODING, item.at);
+        }
+
+        return fail(status, JSONError::UNEXPECTED_END, end);
+    }
+
+    bool CBORReader::read(Item& item, JSONStatus& status)
+    {
+        item = Item{};
+        bool tagged = false;
+        bool embedded_json = false;
+
+        // Tags other than embedded JSON are skipped, leaving the value they annotate
+        while(true)
+        {
+            item.at = ch;
+            if(ch == end) return fail(status, JSONError::UNEXPECTED_END, ch);
+
+            std::uint8_t byte = static_cast<unsigned char>(*ch++);
+            std::uint8_t major = byte >> 5;
+            std::uint8_t info = byte & 0x1F;
+
+            if(major == 7)
+            {
+                // A tag annotates a value, never the end of a container
+                if(embedded_json || (tagged && info == 31)) return fail(status, JSONError::INVALID_ENCODING, item.at);
+                return readSimple(item, info, status);
+            }
+
+            if(info == 31)
+            {
+                if(embedded_json) return fail(status, JSONError::INVALID_ENCODING, item.at);
+                if(major == 3) return readChunks(item, status);
+                if(major != 4 && major != 5) return fail(status, JSONError::INVALID_ENCODING, item.at);
+
+                item.kind = major == 4 ? ItemKind::ARRAY : ItemKind::MAP;
+                item.indefinite = true;
+                return true;
+            }
+
+            std::uint64_t value;
+            if(info > 27) return fail(status, JSONError::INVALID_ENCODING, item.at);
+            if(!argument(info, value)) return fail(status, JSONError::UNEXPECTED_END, end);
+
+            if(embedded_json && major != 2) return fail(status, JSONError::INVALID_ENCODING, item.at);
+
+            switch(major)
+            {
+                case 0:
+                    SetUnsigned(item, value);
+                    return true;
+
+                case 1:
+                    if(value <= INT64_MAX)
+                    {
+                        item.kind = ItemKind::INT64;
+                        item.number.int64 = -1 - static_cast<std::int64_t>(value);
+                        return true;
+                    }
+                    else
+                    {
+                        // Below INT64_MIN, kept exact as text
+                        char buffer[max_number_text];
+                        char* buffer_end = value == UINT64_MAX ? nullptr : std::to_chars(buffer, buffer + max_number_text, value + 1).ptr;
+
+                        scratch = "-";
+                        if(buffer_end) scratch.append(buffer, buffer_end);
+                        else scratch += "18446744073709551616";
+
+                        item.kind = ItemKind::NUMBER_TEXT;
+                        item.text = scratch;
+                        return true;
+                    }
+
+                case 2:
+                    // Byte strings only carry number text under the embedded JSON tag
+                    if(!embedded_json) return fail(status, JSONError::INVALID_ENCODING, item.at);
+                    if(!takeBytes(value, item.text)) return fail(status, JSONError::UNEXPECTED_END, end);
+                    item.kind = ItemKind::NUMBER_TEXT;
+                    return true;
+
+                case 3:
+                    if(!takeBytes(value, item.text)) return fail(status, JSONError::UNEXPECTED_END, end);
+                    item.kind = ItemKind::STRING;
+                    return true;
+
+                case 4:
+                case 5:
+                    item.kind = major == 4 ? ItemKind::ARRAY : ItemKind::MAP;
+                    item.count = value;
+                    return true;
+
+                default:
+                    tagged = true;
+                    embedded_json = value == cbor_embedded_json_tag;
+                    continue;
+            }
+        }
+    }
+
+    /*
+        Checks that text is exactly one JSON number.
+    */
+    bool IsNumberText(std::string_view text)
+    {
+        return !text.empty() && (text.front() == '-' || CPPJP::IsDigit(text.front())) && CPPJP::IsDigit(text.back()) &&
+            CPPJP::Validate(text.data(), text.size()).ok();
+    }
+
+    struct Frame
+    {
+        JSONNode* container;
+        JSONNode* last;             // Last child added, so adding the next is O(1)
+        std::uint64_t remaining;    // Entries left in a definite length container
+        bool indefinite;
+    };
+
+    /*
+        Builds the tree described by the items of reader into root.
+        @return ```true``` if successful, ```false``` otherwise with status set.
+    */
+    template<typename Reader>
+    bool Decode(Reader& reader, JSONNode* root, const JSONParseOptions& options, JSONStatus& status)
+    {
+        auto limit = [](size_t value) { return value ? value : SIZE_MAX; };
+        const size_t max_depth = limit(options.max_depth);
+        const size_t max_nodes = limit(options.max_nodes);
+        const size_t max_string_length = limit(options.max_string_length);
+        const size_t max_total_bytes = limit(options.max_total_bytes);
+
+        std::vector<Frame> frames;
+        std::string name;           // Escaped name of the member whose value comes next
+        bool have_name = false;
+        bool have_root = false;
+        size_t node_count = 0;
+        size_t total_bytes = 0;
+
+        auto charge_text = [&](const Item& item) -> bool
+        {
+            if(item.text.size() > max_string_length) return reader.fail(status, JSONError::STRING_TOO_LONG, item.at);
+            if(item.text.size() > max_total_bytes - total_bytes) return reader.fail(status, JSONError::MEMORY_BUDGET_EXCEEDED, item.at);
+            total_bytes += item.text.size();
+            return true;
+        };
+
+        while(true)
+        {
+            // Close definite length containers whose entries are all read
+            while(!frames.empty() && !frames.back().indefinite && frames.back().remaining == 0)
+                frames.pop_back();
+
+            if(frames.empty() && have_root) break;
+
+            Item item;
+            if(!reader.read(item, status)) return false;
+
+            Frame* frame = frames.empty() ? nullptr : &frames.back();
+            bool in_map = frame && frame->container->type == JSONNodeType::OBJECT;
+
+            if(item.kind == ItemKind::BREAK)
+            {
+                if(!frame || !frame->indefinite || have_name) return reader.fail(status, JSONError::INVALID_ENCODING, item.at);
+                frames.pop_back();
+                continue;
+            }
+
+            if(item.kind == ItemKind::STRING)
+            {
+                if(CPPJP::FindInvalidUTF8(item.text.data(), item.text.data() + item.text.size()) != item.text.data() + item.text.size())
+                    return reader.fail(status, JSONError::INVALID_UTF8, item.at);
+                if(!charge_text(item)) return false;
+            }
+
+            if(in_map && !have_name)
+            {
+                if(item.kind != ItemKind::STRING) return reader.fail(status, JSONError::INVALID_ENCODING, item.at);
+
+                name.assign(item.text.data(), item.text.size());
+                have_name = true;
+                continue;
+            }
+
+            if(node_count >= max_nodes) return reader.fail(status, JSONError::TOO_MANY_NODES, item.at);
+            if(sizeof(JSONNode) > max_total_bytes - total_bytes) return reader.fail(status, JSONError::MEMORY_BUDGET_EXCEEDED, item.at);
+            node_count++;
+            total_bytes += sizeof(JSONNode);
+
+            JSONNode* node = root;
+            if(frame)
+            {
+                node = new JSONNode{};
+                node->parent = frame->container;
+                node->previous = frame->last;
+                if(frame->last) frame->last->next = node;
+                else frame->container->child = node;
+                frame->last = node;
+
+                if(!frame->indefinite) frame->remaining--;
+                if(in_map)
+                {
+                    node->name.swap(name);
+                    node->name_hash = CPPJP::NameHash(node->name);
+                    have_name = false;
+                }
+            }
+            have_root = true;
+
+            switch(item.kind)
+            {
+                case ItemKind::JNULL:   node->type = JSONNodeType::JNULL; break;
+                case ItemKind::TRUE:    node->type = JSONNodeType::TRUE; break;
+                case ItemKind::FALSE:   node->type = JSONNodeType::FALSE; break;
+
+                case ItemKind::INT64:
+                    node->type = JSONNodeType::NUMBER;
+                    node->flags = NODE_INT64;
+                    node->number.int64 = item.number.int64;
+                    break;
+
+                case ItemKind::UINT64:
+                    node->type = JSONNodeType::NUMBER;
+                    node->flags = NODE_UINT64;
+                    node->number.uint64 = item.number.uint64;
+                    break;
+
+                case ItemKind::DOUBLE:
+                    // JSON has no representation for infinities and NaN
+                    if(!std::isfinite(item.number.real))
+                    {
+                        node->type = JSONNodeType::JNULL;
+                        break;
+                    }
+                    node->type = JSONNodeType::NUMBER;
+                    node->flags = NODE_DOUBLE;
+                    node->number.real = item.number.real;
+                    break;
+
+                case ItemKind::NUMBER_TEXT:
+                    if(!IsNumberText(item.text)) return reader.fail(status, JSONError::INVALID_NUMBER, item.at);
+                    if(!charge_text(item)) return false;
+                    node->type = JSONNodeType::NUMBER;
+                    node->string_data.assign(item.text);
+                    break;
+
+                case ItemKind::STRING:
+                    node->type = JSONNodeType::STRING;
+                    CPPJP::EscapeString(item.text.data(), item.text.size(), node->string_data);
+                    if(node->string_data.size() != item.text.size()) node->flags = NODE_HAS_ESCAPES;
+                    break;
+
+                case ItemKind::ARRAY:
+                case ItemKind::MAP:
+                {
+                    node->type = item.kind == ItemKind::ARRAY ? JSONNodeType::ARRAY : JSONNodeType::OBJECT;
+
+                    if(frames.size() >= max_depth) return reader.fail(status, JSONError::NESTING_TOO_DEEP, item.at);
+
+                    // Every entry takes at least a byte, which rejects absurd counts before any allocation
+                    std::uint64_t min_bytes = item.kind == ItemKind::MAP ? 2 : 1;
+                    if(!item.indefinite && item.count > reader.remaining() / min_bytes)
+                        return reader.fail(status, JSONError::UNEXPECTED_END, item.at);
+
+                    frames.push_back(Frame{ node, nullptr, item.count, item.indefinite });
+                } break;
+
+                case ItemKind::BREAK:
+                    break;
+            }
+        }
+
+        if(!reader.atEnd())
+        {
+            Item item;
+            reader.read(item, status);
+            return reader.fail(status, JSONError::TRAILING_CHARACTERS, item.at);
+        }
+
+        return true;
+    }
+
+    template<typename Reader>
+    JSON DecodeToJSON(const char* data, size_t length, const JSONParseOptions& options, JSONStatus* status)
+    {
+        JSONNode* root = new JSONNode{};
+        JSONStatus result;
+
+        Reader reader(data, data + length);
+        bool success = data && Decode(reader, root, options, result);
+        if(!data) result = JSONStatus{ JSONError::UNEXPECTED_END, 0 };
+
+        if(status) *status = result;
+        if(success) return JSON::Adopt(root);
+
+        CPPJP::FreeNode(root);
+        return JSON::Adopt(nullptr);
+    }
+}
+
+void JSON::toMessagePack(std::string& out) const
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    MessagePackWriter writer(out);
+    Encode(this->node, writer);
+}
+
+void JSON::toCBOR(std::string& out) const
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    CBORWriter writer(out);
+    Encode(this->node, writer);
+}
+
+JSON JSON::FromMessagePack(const char* data, size_t length, const JSONParseOptions& options, JSONStatus* status)
+{
+    return DecodeToJSON<MessagePackReader>(data, length, options, status);
+}
+
+JSON JSON::FromCBOR(const char* data, size_t length, const JSONParseOptions& options, JSONStatus* status)
+{
+    return DecodeToJSON<CBORReader>(data, length, options, status);
+}
@@ -0,0 +1,291 @@
+#include "cppjp_bind.hpp"
+#include "scan.hpp"
+
+namespace
+{
+    // Values nested deeper than this are rejected while skipping
+    const size_t max_skip_depth = 1024;
+}
+
+CPPJP::BindReader::BindReader(const char* str, size_t length)
+    : begin(str), ch(str), end(str + length), value_start(str), depth(0)
+{}
+
+void CPPJP::BindReader::skipSpace()
+{
+    ch = SkipJSONSpace(ch, end);
+    value_start = ch;
+}
+
+bool CPPJP::BindReader::fail(JSONError error, const char* at)
+{
+    // Keep the first error, later failures are consequences of it
+    if(current_status.ok())
+    {
+        current_status.error = error;
+        current_status.offset = at - begin;
+    }
+    return false;
+}
+
+bool CPPJP::BindReader::mismatch()
+{
+    return fail(value_start == end ? JSONError::UNEXPECTED_END : JSONError::TYPE_MISMATCH, value_start);
+}
+
+bool CPPJP::BindReader::consume(char expected)
+{
+    skipSpace();
+    if(ch == end || *ch != expected) return false;
+
+    ch++;
+    return true;
+}
+
+bool CPPJP::BindReader::expect(char expected)
+{
+    if(consume(expected)) return true;
+
+    return fail(ch == end ? JSONError::UNEXPECTED_END : JSONError::UNEXPECTED_CHARACTER, ch);
+}
+
+bool CPPJP::BindReader::readNull()
+{
+    skipSpace();
+    if(end - ch < 4 || memcmp(ch, "null", 4) != 0) return false;
+
+    ch += 4;
+    return true;
+}
+
+bool CPPJP::BindReader::readBool(bool& value)
+{
+    skipSpace();
+
+    if(end - ch >= 4 && memcmp(ch, "true", 4) == 0)
+    {
+        value = true;
+        ch += 4;
+        return true;
+    }
+
+    if(end - ch >= 5 && memcmp(ch, "false", 5) == 0)
+    {
+        value = false;
+        ch += 5;
+        return true;
+    }
+
+    return mismatch();
+}
+
+bool CPPJP::BindReader::readNumber(const char*& number_begin, const char*& number_end)
+{
+    skipSpace();
+    const char* start = ch;
+    const char* cur = ch;
+
+    if(cur < end && *cur == '-') cur++;
+
+    if(cur == end || !IsDigit(*cur))
+    {
+        // Not a number at all is a type mismatch, a broken number is malformed JSON
+        if(cur == start) return mismatch();
+        return fail(JSONError::INVALID_NUMBER, start);
+    }
+
+    // No leading zeros
+    if(*cur == '0') cur++;
+    else while(cur < end && IsDigit(*cur)) cur++;
+
+    if(cur < end && *cur == '.')
+    {
+        cur++;
+        if(cur == end || !IsDigit(*cur)) return fail(JSONError::INVALID_NUMBER, start);
+        while(cur < end && IsDigit(*cur)) cur++;
+    }
+
+    if(cur < end && (*cur == 'e' || *cur == 'E'))
+    {
+        cur++;
+        if(cur < end && (*cur == '+' || *cur == '-')) cur++;
+        if(cur == end || !IsDigit(*cur)) return fail(JSONError::INVALID_NUMBER, start);
+        while(cur < end && IsDigit(*cur)) cur++;
+    }
+
+    number_begin = start;
+    number_end = cur;
+    ch = cur;
+    return true;
+}
+
+/*
+    Scans the string whose opening quote is at ch, leaving ch past the closing quote.
+    @return A pointer to the closing quote, or nullptr on error.
+*/
+const char* CPPJP::BindReader::scanString(bool& has_escapes)
+{
+    const char* cur = ch + 1;
+    has_escapes = false;
+
+    while(true)
+    {
+        cur = FindStringSpecial(cur, end);
+
+        if(cur == end)
+        {
+            fail(JSONError::UNEXPECTED_END, cur);
+            return nullptr;
+        }
+
+        if(*cur == '"')
+        {
+            ch = cur + 1;
+            return cur;
+        }
+
+        if(*cur != '\\')
+        {
+            fail(JSONError::INVALID_STRING, cur);
+            return nullptr;
+        }
+
+        const char* escape = cur;
+        cur++;
+        if(cur == end) continue;
+
+        switch(*cur)
+        {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                cur++;
+                break;
+
+            case 'u':
+                if(end - cur < 5)
+                {
+                    cur = end;
+                    break;
+                }
+                if(!IsHexDigit(cur[1]) || !IsHexDigit(cur[2]) || !IsHexDigit(cur[3]) || !IsHexDigit(cur[4]))
+                {
+                    fail(JSONError::INVALID_ESCAPE, escape);
+                    return nullptr;
+                }
+                cur += 5;
+                break;
+
+            default:
+                fail(JSONError::INVALID_ESCAPE, escape);
+                return nullptr;
+        }
+
+        has_escapes = true;
+    }
+}
+
+bool CPPJP::BindReader::readString(std::string& out)
+{
+    skipSpace();
+    if(ch == end || *ch != '"') return mismatch();
+
+    const char* body = ch + 1;
+    bool has_escapes;
+    const char* closing = scanString(has_escapes);
+    if(!closing) return false;
+
+    out.clear();
+    if(has_escapes) DecodeString(body, closing - body, out);
+    else out.assign(body, closing);
+
+    return true;
+}
+
+bool CPPJP::BindReader::readKey(std::string_view& key)
+{
+    skipSpace();
+    if(ch == end) return fail(JSONError::UNEXPECTED_END, ch);
+    if(*ch != '"') return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+
+    const char* body = ch + 1;
+    bool has_escapes;
+    const char* closing = scanString(has_escapes);
+    if(!closing) return false;
+
+    if(has_escapes)
+    {
+        key_buffer.clear();
+        DecodeString(body, closing - body, key_buffer);
+        key = key_buffer;
+    }
+    else
+        key = std::string_view(body, closing - body);
+
+    return expect(':');
+}
+
+bool CPPJP::BindReader::skipValue()
+{
+    skipSpace();
+    if(ch == end) return fail(JSONError::UNEXPECTED_END, ch);
+
+    switch(*ch)
+    {
+        case '"':
+        {
+            bool has_escapes;
+            return scanString(has_escapes) != nullptr;
+        }
+
+        case 't':
+        case 'f':
+        case 'n':
+        {
+            const char* literal = *ch == 't' ? "true" : *ch == 'f' ? "false" : "null";
+            size_t length = strlen(literal);
+            if(static_cast<size_t>(end - ch) < length || memcmp(ch, literal, length) != 0)
+                return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+
+            ch += length;
+            return true;
+        }
+
+        case '[':
+        case '{':
+        {
+            bool is_object = *ch == '{';
+            char closing = is_object ? '}' : ']';
+
+            if(depth == max_skip_depth) return fail(JSONError::NESTING_TOO_DEEP, ch);
+            ch++;
+            if(consume(closing)) return true;
+
+            depth++;
+            do
+            {
+                std::string_view key;
+                if(is_object && !readKey(key)) return false;
+                if(!skipValue()) return false;
+            } while(consume(','));
+            depth--;
+
+            return expect(closing);
+        }
+
+        default:
+        {
+            if(*ch != '-' && !IsDigit(*ch)) return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+
+            const char* number_begin;
+            const char* number_end;
+            return readNumber(number_begin, number_end);
+        }
+    }
+}
+
+bool CPPJP::BindReader::finish()
+{
+    skipSpace();
+    if(ch != end) return fail(JSONError::TRAILING_CHARACTERS, ch);
+
+    return true;
+}
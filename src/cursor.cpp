@@ -0,0 +1,380 @@
+#include <cerrno>
+#include <istream>
+#include <unistd.h>
+#include "cppjp_cursor.hpp"
+#include "exceptions.hpp"
+#include "parser.hpp"
+#include "scan.hpp"
+
+namespace
+{
+    const size_t cursor_block_size = 64 * 1024;
+
+    // Ends a number or keyword; anything else is part of it and rejected when the value is checked
+    bool EndsScalar(char ch)
+    {
+        return ch == ',' || ch == ']' || ch == '}' || CPPJP::IsJSONSpace(ch);
+    }
+}
+
+JSONCursor JSONCursor::FromJSONString(const char* str, size_t length, const JSONParseOptions& options)
+{
+    JSONCursor cursor;
+    cursor.text = str ? str : "";
+    cursor.length = str ? length : 0;
+    cursor.options = options;
+    return cursor;
+}
+
+JSONCursor JSONCursor::FromStream(int fd, const JSONParseOptions& options)
+{
+    JSONCursor cursor;
+    cursor.options = options;
+    cursor.read = [fd](char* buffer, size_t size) -> long
+    {
+        while(true)
+        {
+            ssize_t count = ::read(fd, buffer, size);
+            if(count >= 0 || errno != EINTR) return count;
+        }
+    };
+    return cursor;
+}
+
+JSONCursor JSONCursor::FromStream(std::istream& stream, const JSONParseOptions& options)
+{
+    JSONCursor cursor;
+    cursor.options = options;
+    cursor.read = [&stream](char* buffer, size_t size) -> long
+    {
+        stream.read(buffer, size);
+        if(stream.bad()) return -1;
+        return stream.gcount();
+    };
+    return cursor;
+}
+
+/*
+    Discards the input before position and reads another block after the available input.
+    Positions relative to position stay valid.
+    @return ```false``` once the input is exhausted, with read_failed set on a read error.
+*/
+bool JSONCursor::fill()
+{
+    if(!read || input_ended) return false;
+
+    if(position)
+    {
+        buffer.erase(0, position);
+        base_offset += position;
+        length -= position;
+        position = 0;
+    }
+
+    buffer.resize(length + cursor_block_size);
+    long count = read(&buffer[length], cursor_block_size);
+
+    if(count <= 0)
+    {
+        input_ended = true;
+        read_failed = count < 0;
+        buffer.resize(length);
+        return false;
+    }
+
+    length += count;
+    buffer.resize(length);
+    return true;
+}
+
+/*
+    Moves position past whitespace.
+    @return ```false``` if the input ends first.
+*/
+bool JSONCursor::skipSpace()
+{
+    while(true)
+    {
+        position = CPPJP::SkipJSONSpace(data() + position, data() + length) - data();
+        if(position < length) return true;
+        if(!fill()) return false;
+    }
+}
+
+bool JSONCursor::fail(JSONError error_code, size_t at)
+{
+    error = JSONStatus{ error_code, base_offset + at };
+    value_pending = false;
+    return false;
+}
+
+bool JSONCursor::failAtEnd()
+{
+    return fail(read_failed ? JSONError::READ_FAILED : JSONError::UNEXPECTED_END, length);
+}
+
+/*
+    Places the cursor on the value starting at position.
+*/
+bool JSONCursor::beginValue()
+{
+    char ch = data()[position];
+
+    switch(ch)
+    {
+        case '{': current_type = JSONNodeType::OBJECT; break;
+        case '[': current_type = JSONNodeType::ARRAY; break;
+        case '"': current_type = JSONNodeType::STRING; break;
+        case 't': current_type = JSONNodeType::TRUE; break;
+        case 'f': current_type = JSONNodeType::FALSE; break;
+        case 'n': current_type = JSONNodeType::JNULL; break;
+
+        default:
+            if(ch != '-' && !CPPJP::IsDigit(ch)) return fail(JSONError::UNEXPECTED_CHARACTER, position);
+            current_type = JSONNodeType::NUMBER;
+    }
+
+    value_pending = true;
+    return true;
+}
+
+/*
+    Finds the end of the value starting at position, reading more input as needed. Only
+    brackets and strings are tracked; the value's text is checked when it is read or skipped,
+    which also reports a value cut off by the end of the input.
+    @param value_length Set to the length of the value's text.
+    @return ```false``` only if reading the input failed.
+*/
+bool JSONCursor::scanValue(size_t& value_length)
+{
+    char first = data()[position];
+    bool in_string = first == '"';
+    bool escaped = false;
+    bool scalar = !in_string && first != '[' && first != '{';
+    size_t depth = scalar || in_string ? 0 : 1;
+    size_t scan = 1;
+
+    while(true)
+    {
+        const char* begin = data() + position;
+        const char* end = data() + length;
+        const char* ch = begin + scan;
+
+        while(ch < end)
+        {
+            if(in_string)
+            {
+                if(escaped)
+                {
+                    escaped = false;
+                    ch++;
+                    continue;
+                }
+
+                ch = CPPJP::FindStringSpecial(ch, end);
+                if(ch == end) break;
+
+                if(*ch == '\\') escaped = true;
+                else if(*ch == '"')
+                {
+                    in_string = false;
+                    if(depth == 0)
+                    {
+                        value_length = ch + 1 - begin;
+                        return true;
+                    }
+                }
+
+                ch++;
+                continue;
+            }
+
+            if(scalar)
+            {
+                if(EndsScalar(*ch))
+                {
+                    value_length = ch - begin;
+                    return true;
+                }
+
+                ch++;
+                continue;
+            }
+
+            switch(*ch)
+            {
+                case '"':
+                    in_string = true;
+                    break;
+
+                case '[':
+                case '{':
+                    depth++;
+                    break;
+
+                case ']':
+                case '}':
+                    if(--depth == 0)
+                    {
+                        value_length = ch + 1 - begin;
+                        return true;
+                    }
+                    break;
+            }
+
+            ch++;
+        }
+
+        scan = ch - begin;
+        if(!fill())
+        {
+            if(read_failed) return failAtEnd();
+
+            value_length = scan;
+            return true;
+        }
+    }
+}
+
+/*
+    Finds the text of the current value for reading or skipping it.
+*/
+bool JSONCursor::takeValue(size_t& value_length)
+{
+    if(!error.ok()) return false;
+    if(!value_pending) throw json::bad_node_access();
+
+    return scanValue(value_length);
+}
+
+/*
+    Reads the member name at position and the colon after it, leaving position at the value.
+*/
+bool JSONCursor::readName()
+{
+    if(data()[position] != '"') return fail(JSONError::UNEXPECTED_CHARACTER, position);
+
+    size_t name_length;
+    if(!scanValue(name_length)) return false;
+
+    const char* name = data() + position;
+    JSONStatus status = CPPJP::Validate(name, name_length, options.validate_utf8);
+    if(!status.ok()) return fail(status.error, position + status.offset);
+    if(options.max_string_length && name_length - 2 > options.max_string_length) return fail(JSONError::STRING_TOO_LONG, position);
+
+    member_name.clear();
+    CPPJP::DecodeString(name + 1, name_length - 2, member_name);
+    position += name_length;
+
+    if(!skipSpace()) return failAtEnd();
+    if(data()[position] != ':') return fail(JSONError::UNEXPECTED_CHARACTER, position);
+    position++;
+
+    if(!skipSpace()) return failAtEnd();
+    return true;
+}
+
+bool JSONCursor::next()
+{
+    if(!error.ok()) return false;
+    if(value_pending && !skipValue()) return false;
+
+    if(!skipSpace())
+    {
+        // Only the end of the document may be followed by the end of the input
+        if(started && containers.empty() && !read_failed) return false;
+        return failAtEnd();
+    }
+
+    if(containers.empty())
+    {
+        if(started) return fail(JSONError::TRAILING_CHARACTERS, position);
+
+        started = true;
+        return beginValue();
+    }
+
+    char closing = containers.back();
+    if(data()[position] == closing)
+    {
+        position++;
+        containers.pop_back();
+        first_member = false;
+        member_name.clear();
+        return false;
+    }
+
+    if(!first_member)
+    {
+        if(data()[position] != ',') return fail(JSONError::UNEXPECTED_CHARACTER, position);
+        position++;
+        if(!skipSpace()) return failAtEnd();
+    }
+    first_member = false;
+
+    if(closing == '}')
+    {
+        if(!readName()) return false;
+    }
+    else
+        member_name.clear();
+
+    return beginValue();
+}
+
+bool JSONCursor::enter(JSONNodeType type, char closing)
+{
+    if(!error.ok()) return false;
+    if(!value_pending) throw json::bad_node_access();
+    if(current_type != type) throw json::invalid_node_type(type, current_type);
+
+    if(options.max_depth && containers.size() + 1 > options.max_depth) return fail(JSONError::NESTING_TOO_DEEP, position);
+
+    position++;
+    containers.push_back(closing);
+    first_member = true;
+    value_pending = false;
+    return true;
+}
+
+bool JSONCursor::enterArray() { return enter(JSONNodeType::ARRAY, ']'); }
+bool JSONCursor::enterObject() { return enter(JSONNodeType::OBJECT, '}'); }
+
+bool JSONCursor::skipValue()
+{
+    size_t value_length;
+    if(!takeValue(value_length)) return false;
+
+    JSONStatus status = CPPJP::Validate(data() + position, value_length, options.validate_utf8);
+    if(!status.ok()) return fail(status.error, position + status.offset);
+
+    position += value_length;
+    value_pending = false;
+    return true;
+}
+
+JSON JSONCursor::readValue()
+{
+    size_t value_length;
+    if(!takeValue(value_length)) return JSON::Adopt(nullptr);
+
+    const char* begin = data() + position;
+    const char* end = begin + value_length;
+    JSONNode* root = new JSONNode;
+
+    // The containers entered around the value count against max_depth
+    CPPJP::ParseContext ctx;
+    CPPJP::BeginParse(ctx, root, begin, options);
+    ctx.depth = containers.size();
+
+    if(!CPPJP::ParsePartialRange(ctx, begin, end, 0) || !CPPJP::EndParse(ctx, end))
+    {
+        CPPJP::FreeNode(root);
+        fail(ctx.status.error, position + ctx.status.offset);
+        return JSON::Adopt(nullptr);
+    }
+
+    position += value_length;
+    value_pending = false;
+    return JSON::Adopt(root);
+}
@@ -0,0 +1,314 @@
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include "cppjp_document.hpp"
+#include "parser.hpp"
+#include "standalone.hpp"
+
+namespace
+{
+    const size_t checkpoint_interval = 64;
+
+    struct PathEntry
+    {
+        JSONNode* node;
+        size_t offset;      // Absolute offset of node in the text before the edit
+    };
+
+    void Shift(size_t& value, std::ptrdiff_t delta)
+    {
+        value = static_cast<size_t>(static_cast<std::ptrdiff_t>(value) + delta);
+    }
+
+    bool IsContainer(const JSONNode* node)
+    {
+        return node->type == JSONNodeType::ARRAY || node->type == JSONNodeType::OBJECT;
+    }
+
+    /*
+        Checks whether re-parsing node alone can absorb an edit of [begin, end). An edit of a
+        container must stay between its brackets, an edit of a scalar within its text.
+    */
+    bool Encloses(const JSONNode* node, size_t offset, size_t begin, size_t end)
+    {
+        if(IsContainer(node))
+            return offset < begin && end < offset + SourceLength(node);
+
+        return offset <= begin && end <= offset + SourceLength(node);
+    }
+
+    /*
+        Returns the source checkpoints of a container, recording every checkpoint_interval-th
+        child on first use. Containers with fewer children than that have none.
+    */
+    const std::vector<JSONSourceCheckpoint>* Checkpoints(JSONNode* container)
+    {
+        if(container->extra && container->extra->checkpoints) return container->extra->checkpoints.get();
+
+        std::vector<JSONSourceCheckpoint> checkpoints;
+        size_t offset = 0;
+        size_t index = 0;
+
+        for(JSONNode* child = container->child; child; child = child->next, index++)
+        {
+            offset += SourceOffset(child);
+            if(index % checkpoint_interval == 0) checkpoints.push_back(JSONSourceCheckpoint{ child, offset });
+        }
+
+        if(index <= checkpoint_interval) return nullptr;
+
+        for(const JSONSourceCheckpoint& checkpoint : checkpoints)
+            checkpoint.node->flags |= NODE_CHECKPOINT;
+
+        NodeExtra(container).checkpoints.reset(new std::vector<JSONSourceCheckpoint>(std::move(checkpoints)));
+        return container->extra->checkpoints.get();
+    }
+
+    /*
+        Finds the last child of container that starts at or before position, or the first
+        child, to start looking for the child at position from.
+        @param offset Absolute offset of container on input, of the returned child on output.
+    */
+    JSONNode* SeekChild(JSONNode* container, size_t position, size_t& offset)
+    {
+        const std::vector<JSONSourceCheckpoint>* checkpoints = Checkpoints(container);
+
+        if(!checkpoints)
+        {
+            JSONNode* child = container->child;
+            if(child) offset += SourceOffset(child);
+            return child;
+        }
+
+        size_t relative = position - offset;
+        auto after = std::upper_bound(checkpoints->begin(), checkpoints->end(), relative,
+            [](size_t value, const JSONSourceCheckpoint& checkpoint){ return value < checkpoint.offset; });
+        if(after != checkpoints->begin()) after--;
+
+        offset += after->offset;
+        return after->node;
+    }
+
+    /*
+        Moves the checkpoints of container that start after position by delta.
+    */
+    void ShiftCheckpoints(JSONNode* container, size_t position, std::ptrdiff_t delta)
+    {
+        if(!container->extra || !container->extra->checkpoints) return;
+
+        std::vector<JSONSourceCheckpoint>& checkpoints = *container->extra->checkpoints;
+        auto after = std::upper_bound(checkpoints.begin(), checkpoints.end(), position,
+            [](size_t value, const JSONSourceCheckpoint& checkpoint){ return value < checkpoint.offset; });
+
+        for(; after != checkpoints.end(); after++)
+            Shift(after->offset, delta);
+    }
+
+    /*
+        Finds the offset of a child from its container if it is one of the container's
+        checkpoints.
+    */
+    bool CheckpointOffset(const JSONNode* child, size_t& offset)
+    {
+        if(!(child->flags & NODE_CHECKPOINT) || !child->parent || !child->parent->extra || !child->parent->extra->checkpoints) return false;
+
+        for(const JSONSourceCheckpoint& checkpoint : *child->parent->extra->checkpoints)
+        {
+            if(checkpoint.node == child)
+            {
+                offset = checkpoint.offset;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    /*
+        Parses [begin, end) as one value found at offset in the text.
+        @param depth Number of containers around the value, counted against max_depth.
+        @return The parsed node, or nullptr with status set.
+    */
+    JSONNode* ParseValue(const char* begin, const char* end, size_t offset, size_t depth, const JSONParseOptions& options, JSONStatus& status)
+    {
+        JSONNode* node = new JSONNode;
+
+        CPPJP::ParseContext ctx;
+        CPPJP::BeginParse(ctx, node, begin, options);
+        ctx.depth = depth;
+
+        bool success = CPPJP::ParsePartialRange(ctx, begin, end, offset) && CPPJP::EndParse(ctx, end);
+        status = ctx.status;
+
+        if(success) return node;
+
+        CPPJP::FreeNode(node);
+        return nullptr;
+    }
+
+    /*
+        Replaces the value of target with the value of replacement, which is freed together with
+        the previous children of target. target keeps its name, its place in the tree and the
+        offset it records relative to its siblings.
+    */
+    void Splice(JSONNode* target, JSONNode* replacement)
+    {
+        CPPJP::TouchNode(target);
+        DropCheckpoints(target);
+
+        std::swap(target->child, replacement->child);
+        for(JSONNode* child = target->child; child; child = child->next) child->parent = target;
+        for(JSONNode* child = replacement->child; child; child = child->next) child->parent = replacement;
+
+        // The replacement was parsed with track_source, so it has out of line data
+        JSONNodeExtra& extra = NodeExtra(target);
+        target->type = replacement->type;
+        target->string_data.swap(replacement->string_data);
+        extra.decoded_data.swap(replacement->extra->decoded_data);
+        target->flags = replacement->flags | (target->flags & NODE_CHECKPOINT);
+        target->number = replacement->number;
+        extra.source_length = replacement->extra->source_length;
+
+        CPPJP::FreeNode(replacement);
+    }
+}
+
+JSONDocument::JSONDocument()
+    : tree(JSON::Adopt(nullptr))
+{}
+
+JSONDocument JSONDocument::Parse(std::string text, const JSONParseOptions& options, JSONStatus* status)
+{
+    JSONDocument document;
+    document.source = std::move(text);
+    document.options = options;
+    document.options.track_source = true;
+    document.parseAll(status);
+    return document;
+}
+
+bool JSONDocument::parseAll(JSONStatus* status)
+{
+    tree = JSON::FromJSONString(source.data(), source.size(), options, status);
+    return tree.isValid();
+}
+
+bool JSONDocument::edit(size_t offset, size_t length, std::string_view replacement, JSONStatus* status)
+{
+    if(offset > source.size() || length > source.size() - offset)
+        throw std::out_of_range("JSONDocument::edit: The edited range is outside the text");
+
+    source.replace(offset, length, replacement.data(), replacement.size());
+    if(!tree.isValid()) return parseAll(status);
+
+    std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(replacement.size()) - static_cast<std::ptrdiff_t>(length);
+    size_t edit_end = offset + length;
+
+    // Walk down to the innermost value that encloses the edit
+    std::vector<PathEntry> path;
+    JSONNode* root = tree.borrowNode();
+    if(Encloses(root, SourceOffset(root), offset, edit_end))
+        path.push_back(PathEntry{ root, SourceOffset(root) });
+
+    while(!path.empty() && IsContainer(path.back().node))
+    {
+        PathEntry parent = path.back();
+        size_t child_offset = parent.offset;
+        bool found = false;
+
+        JSONNode* child = SeekChild(parent.node, offset, child_offset);
+        while(child && child_offset <= offset)
+        {
+            if(Encloses(child, child_offset, offset, edit_end))
+            {
+                path.push_back(PathEntry{ child, child_offset });
+                found = true;
+                break;
+            }
+
+            child = child->next;
+            if(child) child_offset += SourceOffset(child);
+        }
+
+        if(!found) break;
+    }
+
+    // Re-parse the innermost value, and its container if a scalar edit changed more than the scalar
+    while(!path.empty())
+    {
+        PathEntry target = path.back();
+        path.pop_back();
+
+        const char* begin = source.data() + target.offset;
+        const char* end = begin + SourceLength(target.node) + delta;
+
+        JSONStatus value_status;
+        JSONNode* replacement = ParseValue(begin, end, target.offset, path.size(), options, value_status);
+
+        // The value must still start where it did, or the offsets recorded around it are wrong
+        if(replacement && SourceOffset(replacement) != target.offset)
+        {
+            CPPJP::FreeNode(replacement);
+            replacement = nullptr;
+        }
+
+        if(!replacement)
+        {
+            if(IsContainer(target.node)) break;
+            continue;
+        }
+
+        Splice(target.node, replacement);
+
+        // Everything after the edit moved by delta, the ancestors grew by it
+        for(JSONNode* node = target.node; node; node = node->parent)
+        {
+            if(node != target.node) Shift(NodeExtra(node).source_length, delta);
+            if(node->next) Shift(NodeExtra(node->next).source_offset, delta);
+        }
+
+        // So did the checkpoints after the path in each container around the value
+        size_t child_offset = target.offset;
+        for(size_t i = path.size(); i-- > 0;)
+        {
+            ShiftCheckpoints(path[i].node, child_offset - path[i].offset, delta);
+            child_offset = path[i].offset;
+        }
+
+        if(status) *status = JSONStatus{};
+        return true;
+    }
+
+    return parseAll(status);
+}
+
+JSONSpan JSONDocument::spanOf(const JSONNode* value) const
+{
+    JSONSpan span;
+    span.length = SourceLength(value);
+
+    // Offsets are relative to the previous sibling, or to the parent for a first child, so each
+    // level is walked back to its first child or to a checkpoint, which is relative to the parent
+    for(const JSONNode* node = value; node; node = node->parent)
+    {
+        if(node->parent) Checkpoints(const_cast<JSONNode*>(node->parent));
+
+        while(true)
+        {
+            size_t checkpoint_offset;
+            if(CheckpointOffset(node, checkpoint_offset))
+            {
+                span.offset += checkpoint_offset;
+                break;
+            }
+
+            span.offset += SourceOffset(node);
+            if(!node->previous) break;
+            node = node->previous;
+        }
+    }
+
+    return span;
+}
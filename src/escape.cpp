@@ -0,0 +1,190 @@
+#include <cstring>
+#include "cppjp.hpp"
+#include "scan.hpp"
+
+/*
+    Escape decoding and encoding of JSON string contents.
+
+    Both directions search for the next byte that needs attention with a vectorised scan and
+    copy the plain run before it in a single append, so strings that are mostly plain text
+    cost little more than a memcpy. The escapes themselves are handled through lookup tables.
+*/
+
+namespace
+{
+    struct EscapeTables
+    {
+        char decode[256] = {};              // Character produced by \x, 0 if x is not a short escape
+        signed char hex[256] = {};          // Value of a hex digit, -1 otherwise
+        char encode[0x20 + 1] = {};         // Short escape for control characters, 0 for \u00XX
+
+        constexpr EscapeTables()
+        {
+            for(int i = 0; i < 256; i++) hex[i] = -1;
+            for(int i = 0; i < 10; i++) hex['0' + i] = i;
+            for(int i = 0; i < 6; i++) hex['a' + i] = hex['A' + i] = 10 + i;
+
+            decode['"'] = '"';
+            decode['\\'] = '\\';
+            decode['/'] = '/';
+            decode['b'] = '\b';
+            decode['f'] = '\f';
+            decode['n'] = '\n';
+            decode['r'] = '\r';
+            decode['t'] = '\t';
+
+            encode['\b'] = 'b';
+            encode['\f'] = 'f';
+            encode['\n'] = 'n';
+            encode['\r'] = 'r';
+            encode['\t'] = 't';
+        }
+    };
+
+    constexpr EscapeTables tables;
+
+    /*
+        Reads the 4 hex digits at str.
+        @return The value of the digits, or -1 if any of them is not a hex digit.
+    */
+    long ReadHex4(const char* str)
+    {
+        long value = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            signed char digit = tables.hex[static_cast<unsigned char>(str[i])];
+            if(digit < 0) return -1;
+            value = (value << 4) | digit;
+        }
+        return value;
+    }
+
+    void AppendUTF8(std::uint32_t code_point, std::string& out)
+    {
+        char bytes[4];
+        size_t count;
+
+        if(code_point < 0x80)
+        {
+            bytes[0] = static_cast<char>(code_point);
+            count = 1;
+        }
+        else if(code_point < 0x800)
+        {
+            bytes[0] = static_cast<char>(0xC0 | (code_point >> 6));
+            bytes[1] = static_cast<char>(0x80 | (code_point & 0x3F));
+            count = 2;
+        }
+        else if(code_point < 0x10000)
+        {
+            bytes[0] = static_cast<char>(0xE0 | (code_point >> 12));
+            bytes[1] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            bytes[2] = static_cast<char>(0x80 | (code_point & 0x3F));
+            count = 3;
+        }
+        else
+        {
+            bytes[0] = static_cast<char>(0xF0 | (code_point >> 18));
+            bytes[1] = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+            bytes[2] = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+            bytes[3] = static_cast<char>(0x80 | (code_point & 0x3F));
+            count = 4;
+        }
+
+        out.append(bytes, count);
+    }
+}
+
+bool CPPJP::DecodeString(const char* str, size_t length, std::string& out)
+{
+    const char* ch = str;
+    const char* end = str + length;
+
+    // Decoded text is never longer than its escaped form
+    out.reserve(out.size() + length);
+
+    while(true)
+    {
+        const char* escape = static_cast<const char*>(memchr(ch, '\\', end - ch));
+        if(!escape)
+        {
+            out.append(ch, end - ch);
+            return true;
+        }
+
+        out.append(ch, escape - ch);
+        ch = escape + 1;
+        if(ch == end) return false;
+
+        if(*ch != 'u')
+        {
+            char decoded = tables.decode[static_cast<unsigned char>(*ch)];
+            if(!decoded) return false;
+            out.push_back(decoded);
+            ch++;
+            continue;
+        }
+
+        if(end - ch < 5) return false;
+        long code_point = ReadHex4(ch + 1);
+        if(code_point < 0) return false;
+        ch += 5;
+
+        if(code_point >= 0xD800 && code_point <= 0xDBFF)
+        {
+            // A high surrogate must be followed by an escaped low surrogate to form a pair
+            long low = -1;
+            if(end - ch >= 6 && ch[0] == '\\' && ch[1] == 'u')
+                low = ReadHex4(ch + 2);
+
+            if(low >= 0xDC00 && low <= 0xDFFF)
+            {
+                code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                ch += 6;
+            }
+            else
+                code_point = 0xFFFD;
+        }
+        else if(code_point >= 0xDC00 && code_point <= 0xDFFF)
+            code_point = 0xFFFD;
+
+        AppendUTF8(static_cast<std::uint32_t>(code_point), out);
+    }
+}
+
+void CPPJP::EscapeString(const char* str, size_t length, std::string& out)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    const char* ch = str;
+    const char* end = str + length;
+
+    out.reserve(out.size() + length);
+
+    while(true)
+    {
+        // Quotes, backslashes and control characters are exactly the bytes that need escaping
+        const char* special = FindStringSpecial(ch, end);
+        out.append(ch, special - ch);
+        if(special == end) return;
+
+        unsigned char byte = static_cast<unsigned char>(*special);
+        if(byte == '"' || byte == '\\')
+        {
+            char escaped[2] = { '\\', static_cast<char>(byte) };
+            out.append(escaped, 2);
+        }
+        else if(tables.encode[byte])
+        {
+            char escaped[2] = { '\\', tables.encode[byte] };
+            out.append(escaped, 2);
+        }
+        else
+        {
+            char escaped[6] = { '\\', 'u', '0', '0', hex_digits[byte >> 4], hex_digits[byte & 0xF] };
+            out.append(escaped, 6);
+        }
+
+        ch = special + 1;
+    }
+}
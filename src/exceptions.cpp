@@ -29,4 +29,10 @@ json::bad_node_access::bad_node_access(const char* source)
     message = "JSON::";
     message += source;
     message += ": Attempted access on a JSON object that is not valid.";
+}
+
+json::invalid_schema::invalid_schema(const std::string& reason)
+{
+    message = "JSONSchema::Compile: ";
+    message += reason;
 }
\ No newline at end of file
@@ -23,4 +23,12 @@ namespace json
             bad_node_access(const char* source = __builtin_FUNCTION());
             const char* what() const noexcept override { return message.c_str(); }
     };
+
+    class invalid_schema: public std::exception
+    {
+        private: std::string message;
+        public:
+            invalid_schema(const std::string& reason);
+            const char* what() const noexcept override { return message.c_str(); }
+    };
 };
@@ -0,0 +1,246 @@
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include "cppjp.hpp"
+#include "standalone.hpp"
+
+/*
+    Structural hashing and deep equality.
+
+    A node's hash covers its value but not its name. Array hashes depend on element order,
+    object hashes combine their members with a sum so they do not depend on member order.
+    Strings are hashed and compared in decoded form and numbers by their text. Member names are
+    held decoded by the parser and the binary decoders, so they are used as they are. Documents
+    that differ only in whitespace, member order or how characters in strings or names are
+    escaped are equal.
+
+    Hashes are cached in the node and cleared along the parent chain by TouchNode, so hashing an
+    unchanged tree again is O(1). Equal hashes are confirmed by a walk of both trees that
+    compares values directly, which is O(n) but does no serialisation. Nothing is cached from
+    that walk, so comparing does not write to the nodes once their hashes are computed.
+*/
+
+namespace
+{
+    inline std::uint64_t Mix(std::uint64_t value)
+    {
+        // splitmix64 finaliser
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9ull;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBull;
+        value ^= value >> 31;
+        return value;
+    }
+
+    std::uint64_t HashBytes(const char* data, size_t length, std::uint64_t seed)
+    {
+        std::uint64_t hash = Mix(seed ^ length);
+
+        while(length >= 8)
+        {
+            std::uint64_t word;
+            memcpy(&word, data, 8);
+            hash = Mix(hash ^ word);
+            data += 8;
+            length -= 8;
+        }
+
+        if(length)
+        {
+            std::uint64_t word = 0;
+            memcpy(&word, data, length);
+            hash = Mix(hash ^ word);
+        }
+
+        return hash;
+    }
+
+    /*
+        Computes the hash of a node whose children all have their hashes cached.
+    */
+    std::uint64_t ComputeNodeHash(JSONNode* node)
+    {
+        std::uint64_t seed = static_cast<std::uint64_t>(node->type) + 1;
+
+        switch(node->type)
+        {
+            case JSONNodeType::STRING:
+            {
+                const std::string& text = DecodedString(node);
+                return HashBytes(text.data(), text.size(), seed);
+            }
+
+            case JSONNodeType::NUMBER:
+            {
+                const std::string& text = NumberText(node);
+                return HashBytes(text.data(), text.size(), seed);
+            }
+
+            case JSONNodeType::ARRAY:
+            {
+                std::uint64_t hash = Mix(seed);
+                for(JSONNode* child = node->child; child; child = child->next)
+                    hash = Mix(hash ^ child->hash);
+                return hash;
+            }
+
+            case JSONNodeType::OBJECT:
+            {
+                // Summing makes the result independent of member order
+                std::uint64_t sum = 0;
+                size_t count = 0;
+                for(JSONNode* child = node->child; child; child = child->next)
+                {
+                    sum += Mix(HashBytes(child->name.data(), child->name.size(), seed) ^ child->hash);
+                    count++;
+                }
+                return Mix(Mix(seed) ^ sum ^ count);
+            }
+
+            case JSONNodeType::TRUE:
+            case JSONNodeType::FALSE:
+            case JSONNodeType::JNULL:
+                break;
+        }
+
+        return Mix(seed);
+    }
+
+    /*
+        Compares two nodes, excluding their children, whose hashes are known to be equal.
+    */
+    bool ValuesEqual(JSONNode* a, JSONNode* b)
+    {
+        if(a->type != b->type) return false;
+
+        switch(a->type)
+        {
+            case JSONNodeType::STRING:  return DecodedString(a) == DecodedString(b);
+            case JSONNodeType::NUMBER:  return NumberText(a) == NumberText(b);
+            default:                    return true;
+        }
+    }
+
+    bool MemberOrder(const JSONNode* a, const JSONNode* b)
+    {
+        int order = a->name.compare(b->name);
+        return order < 0 || (order == 0 && a->hash < b->hash);
+    }
+
+    /*
+        Pairs the members of two objects with equal names and hashes and queues the pairs for
+        comparison.
+        @return ```false``` if some member has no partner.
+    */
+    bool PairMembers(JSONNode* a, JSONNode* b, std::vector<std::pair<JSONNode*, JSONNode*>>& pending)
+    {
+        const size_t small_object = 16;
+
+        std::vector<JSONNode*> a_members;
+        std::vector<JSONNode*> b_members;
+        for(JSONNode* child = a->child; child; child = child->next) a_members.push_back(child);
+        for(JSONNode* child = b->child; child; child = child->next) b_members.push_back(child);
+
+        if(a_members.size() != b_members.size()) return false;
+
+        if(a_members.size() <= small_object)
+        {
+            std::uint32_t used = 0;
+            for(JSONNode* a_member : a_members)
+            {
+                size_t match = 0;
+                while(match < b_members.size())
+                {
+                    JSONNode* b_member = b_members[match];
+                    if(!(used & (1u << match)) && a_member->hash == b_member->hash && a_member->name == b_member->name) break;
+                    match++;
+                }
+
+                if(match == b_members.size()) return false;
+
+                used |= 1u << match;
+                pending.emplace_back(a_member, b_members[match]);
+            }
+            return true;
+        }
+
+        std::sort(a_members.begin(), a_members.end(), MemberOrder);
+        std::sort(b_members.begin(), b_members.end(), MemberOrder);
+
+        for(size_t i = 0; i < a_members.size(); i++)
+        {
+            if(a_members[i]->hash != b_members[i]->hash || a_members[i]->name != b_members[i]->name) return false;
+            pending.emplace_back(a_members[i], b_members[i]);
+        }
+
+        return true;
+    }
+}
+
+std::uint64_t CPPJP::HashNode(JSONNode* root)
+{
+    JSONNode* node = root;
+
+    while(true)
+    {
+        // Descend through containers whose hash is not cached
+        while(!(node->flags & NODE_HASHED) && node->child)
+            node = node->child;
+
+        if(!(node->flags & NODE_HASHED))
+        {
+            node->hash = ComputeNodeHash(node);
+            node->flags |= NODE_HASHED;
+        }
+
+        // Move to the next sibling, finishing every container that is left on the way up
+        while(true)
+        {
+            if(node == root) return root->hash;
+
+            if(node->next)
+            {
+                node = node->next;
+                break;
+            }
+
+            node = node->parent;
+            node->hash = ComputeNodeHash(node);
+            node->flags |= NODE_HASHED;
+        }
+    }
+}
+
+bool CPPJP::NodesEqual(JSONNode* a, JSONNode* b)
+{
+    if(a == b) return true;
+    if(HashNode(a) != HashNode(b)) return false;
+
+    // Equal hashes, confirm the structure to rule out collisions
+    std::vector<std::pair<JSONNode*, JSONNode*>> pending{ { a, b } };
+
+    while(!pending.empty())
+    {
+        auto [left, right] = pending.back();
+        pending.pop_back();
+
+        if(left->hash != right->hash || !ValuesEqual(left, right)) return false;
+
+        if(left->type == JSONNodeType::ARRAY)
+        {
+            JSONNode* left_child = left->child;
+            JSONNode* right_child = right->child;
+            for(; left_child && right_child; left_child = left_child->next, right_child = right_child->next)
+                pending.emplace_back(left_child, right_child);
+
+            if(left_child || right_child) return false;
+        }
+        else if(left->type == JSONNodeType::OBJECT)
+        {
+            if(!PairMembers(left, right, pending)) return false;
+        }
+    }
+
+    return true;
+}
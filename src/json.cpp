@@ -2,8 +2,15 @@
 #include "parser.hpp"
 #include "standalone.hpp"
 #include "exceptions.hpp"
+#include "stats.hpp"
+#include "thread_pool.hpp"
 #include <string>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
 #include <exception>
+#include <type_traits>
 
 //
 //  JSON Class
@@ -18,6 +25,15 @@ JSON JSON::FromJSONString(const char* str)
     return json;
 }
 
+JSON JSON::FromJSONString(const char* str, size_t length, const JSONParseOptions& options, JSONStatus* status)
+{
+    JSON json;
+    json.node = new JSONNode;
+    json.is_owning = true;
+    json.is_valid = CPPJP::ParseJSON(str, length, json.node, options, status);
+    return json;
+}
+
 JSON JSON::Wrap(JSONNode* node)
 {
     JSON json;
@@ -191,7 +207,7 @@ std::string JSON::asString() const
     if(this->node->type != JSONNodeType::STRING)
         throw json::invalid_node_type(JSONNodeType::STRING, this->getType());
 
-    return this->node->string_data;
+    return DecodedString(this->node);
 }
 
 const char* JSON::asCString() const
@@ -200,7 +216,7 @@ const char* JSON::asCString() const
     if(this->node->type != JSONNodeType::STRING)
         throw json::invalid_node_type(JSONNodeType::STRING, this->getType());
 
-    return this->node->string_data.c_str();
+    return DecodedString(this->node).c_str();
 }
 
 size_t JSON::asNumber() const
@@ -209,7 +225,8 @@ size_t JSON::asNumber() const
     if(this->node->type != JSONNodeType::NUMBER)
         throw json::invalid_node_type(JSONNodeType::NUMBER, this->getType());
 
-    return std::stoull(this->node->string_data);
+    if(this->node->flags & NODE_UINT64) return this->node->number.uint64;
+    return std::stoull(NumberText(this->node));
 }
 
 ssize_t JSON::asSignedNumber() const
@@ -218,7 +235,8 @@ ssize_t JSON::asSignedNumber() const
     if(this->node->type != JSONNodeType::NUMBER)
         throw json::invalid_node_type(JSONNodeType::NUMBER, this->getType());
 
-    return std::stoll(this->node->string_data);
+    if(this->node->flags & NODE_INT64) return this->node->number.int64;
+    return std::stoll(NumberText(this->node));
 }
 
 double JSON::asFloat() const
@@ -227,7 +245,8 @@ double JSON::asFloat() const
     if(this->node->type != JSONNodeType::NUMBER)
         throw json::invalid_node_type(JSONNodeType::NUMBER, this->getType());
 
-    return std::stod(this->node->string_data);
+    if(this->node->flags & NODE_DOUBLE) return this->node->number.real;
+    return std::stod(NumberText(this->node));
 }
 
 bool JSON::asBool() const
@@ -261,14 +280,7 @@ bool JSON::hasEntry(const char* key) const
     if(this->node->type != JSONNodeType::OBJECT)
         throw json::invalid_node_type(JSONNodeType::OBJECT, this->getType());
 
-    JSONNode* current_node = this->node->child;
-    while(current_node)
-    {
-        if(current_node->name == std::string(key)) return true;
-        current_node = current_node->next;
-    }
-
-    return false;
+    return FindEntry(this->node, key, strlen(key)) != nullptr;
 }
 
 size_t JSON::arraySize() const
@@ -300,14 +312,16 @@ JSONNode* JSON::getRawEntry(const char* key)
     if(this->node->type != JSONNodeType::OBJECT)
         throw json::invalid_node_type(JSONNodeType::OBJECT, this->getType());
 
-    JSONNode* current_node = this->node->child;
-    while(current_node)
-    {
-        if(current_node->name == std::string(key)) return current_node;
-        current_node = current_node->next;
-    }
+    return FindEntry(this->node, key, strlen(key));
+}
+
+JSON JSON::get(const JSONKey& key)
+{
+    if(!isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::OBJECT)
+        throw json::invalid_node_type(JSONNodeType::OBJECT, this->getType());
 
-    return nullptr;
+    return JSON::Wrap(FindEntry(this->node, key.data, key.length, CPPJP::FoldKeyHash(key.hash)));
 }
 
 JSONNode* JSON::getRawElement(size_t index)
@@ -332,15 +346,245 @@ void JSON::iterate(std::function<void(JSON node)> callback)
     if(this->node->type != JSONNodeType::ARRAY && this->node->type != JSONNodeType::OBJECT)
         throw json::invalid_node_type({ JSONNodeType::ARRAY, JSONNodeType::OBJECT }, this->getType());
 
+    forEach([&callback](JSONNode& current_node){ callback(JSON::Wrap(&current_node)); }); // Node could be deleted here
+}
+
+std::vector<JSONNode*> JSON::collectChildren()
+{
+    if(!isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::ARRAY && this->node->type != JSONNodeType::OBJECT)
+        throw json::invalid_node_type({ JSONNodeType::ARRAY, JSONNodeType::OBJECT }, this->getType());
+
+    std::vector<JSONNode*> children;
+    for(JSONNode* current_node = this->node->child; current_node; current_node = current_node->next)
+        children.push_back(current_node);
+
+    return children;
+}
+
+size_t JSON::ParallelRangeCount(size_t count)
+{
+    // Several ranges per thread so that stealing can even out uneven callbacks, but each
+    // range large enough that scheduling it costs little next to the work it holds
+    const size_t min_range_size = 256;
+    const size_t ranges_per_thread = 8;
+
+    size_t max_ranges = static_cast<size_t>(CPPJP::SharedPool().size()) * ranges_per_thread;
+    return std::max<size_t>(1, std::min(max_ranges, count / min_range_size));
+}
+
+JSONIterator JSON::begin()
+{
+    if(!isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::ARRAY && this->node->type != JSONNodeType::OBJECT)
+        throw json::invalid_node_type({ JSONNodeType::ARRAY, JSONNodeType::OBJECT }, this->getType());
+
+    return JSONIterator(this->node->child);
+}
+
+JSONRange<JSONMemberIterator> JSON::items()
+{
+    if(!isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::OBJECT)
+        throw json::invalid_node_type(JSONNodeType::OBJECT, this->getType());
+
+    return { JSONMemberIterator(this->node->child), JSONMemberIterator() };
+}
+
+JSONRange<JSONTreeIterator> JSON::descendants()
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    return { JSONTreeIterator(this->node), JSONTreeIterator() };
+}
+
+//
+//  Non-throwing accessors
+//
+
+namespace
+{
+    /*
+        Parses the whole of a number node's text as T.
+        @return The value, or nothing if the text is not a T or is out of range.
+    */
+    template<typename T>
+    std::optional<T> ParseNumberAs(const JSONNode* node) noexcept
+    {
+        if(node->type != JSONNodeType::NUMBER) return std::nullopt;
+
+        // A binary number of the requested kind needs no conversion
+        if constexpr(std::is_same_v<T, std::int64_t>) { if(node->flags & NODE_INT64) return node->number.int64; }
+        if constexpr(std::is_same_v<T, std::uint64_t>) { if(node->flags & NODE_UINT64) return node->number.uint64; }
+        if constexpr(std::is_same_v<T, double>) { if(node->flags & NODE_DOUBLE) return node->number.real; }
+
+        char buffer[max_number_text];
+        const char* begin = node->string_data.data();
+        const char* end = begin + node->string_data.size();
+        if(IsUnformattedNumber(node))
+        {
+            begin = buffer;
+            end = FormatNumber(node, buffer);
+        }
+
+        T value;
+        std::from_chars_result result = std::from_chars(begin, end, value);
+        if(result.ec != std::errc() || result.ptr != end) return std::nullopt;
+
+        return value;
+    }
+}
+
+std::optional<JSONNodeType> JSON::tryGetType() const noexcept
+{
+    if(!isValid()) return std::nullopt;
+
+    return this->node->type;
+}
+
+std::optional<JSON> JSON::tryGetEntry(const char* key) noexcept
+{
+    if(!isValid() || this->node->type != JSONNodeType::OBJECT) return std::nullopt;
+
+    JSONNode* entry = FindEntry(this->node, key, strlen(key));
+    if(!entry) return std::nullopt;
+    return JSON::Wrap(entry);
+}
+
+std::optional<JSON> JSON::tryGet(const JSONKey& key) noexcept
+{
+    if(!isValid() || this->node->type != JSONNodeType::OBJECT) return std::nullopt;
+
+    JSONNode* entry = FindEntry(this->node, key.data, key.length, CPPJP::FoldKeyHash(key.hash));
+    if(!entry) return std::nullopt;
+    return JSON::Wrap(entry);
+}
+
+std::optional<JSON> JSON::tryGetElement(size_t index) noexcept
+{
+    if(!isValid() || this->node->type != JSONNodeType::ARRAY) return std::nullopt;
+
     JSONNode* current_node = this->node->child;
-    while(current_node)
+    for(size_t i = 0; current_node && i < index; i++)
+        current_node = current_node->next;
+
+    if(!current_node) return std::nullopt;
+    return JSON::Wrap(current_node);
+}
+
+std::optional<std::string_view> JSON::tryAsStringView() const
+{
+    if(!isValid() || this->node->type != JSONNodeType::STRING) return std::nullopt;
+
+    return std::string_view(DecodedString(this->node));
+}
+
+std::optional<std::int64_t> JSON::tryAsInt64() const noexcept
+{
+    if(!isValid()) return std::nullopt;
+
+    return ParseNumberAs<std::int64_t>(this->node);
+}
+
+std::optional<std::uint64_t> JSON::tryAsUint64() const noexcept
+{
+    if(!isValid()) return std::nullopt;
+
+    return ParseNumberAs<std::uint64_t>(this->node);
+}
+
+std::optional<double> JSON::tryAsDouble() const noexcept
+{
+    if(!isValid()) return std::nullopt;
+
+    return ParseNumberAs<double>(this->node);
+}
+
+std::optional<bool> JSON::tryAsBool() const noexcept
+{
+    if(!isValid()) return std::nullopt;
+    if(this->node->type == JSONNodeType::TRUE) return true;
+    if(this->node->type == JSONNodeType::FALSE) return false;
+
+    return std::nullopt;
+}
+
+//
+//  Columnar extraction
+//
+
+namespace
+{
+    template<typename T>
+    std::optional<T> ColumnValue(JSONNode* node)
     {
-        JSONNode* next_node = current_node->next;
-        callback(JSON::Wrap(current_node));               // Node could be deleted here
-        current_node = next_node;
+        if constexpr(std::is_same_v<T, std::string_view>)
+        {
+            if(node->type != JSONNodeType::STRING) return std::nullopt;
+            return std::string_view(DecodedString(node));
+        }
+        else return ParseNumberAs<T>(node);
+    }
+
+    template<typename T>
+    JSONColumn<T> ExtractColumn(JSONNode* array, const char* key, size_t length, std::uint16_t name_hash)
+    {
+        JSONColumn<T> column;
+
+        size_t index = 0;
+        for(JSONNode* element = array->child; element; element = element->next, index++)
+        {
+            if(index % 64 == 0) column.validity.push_back(0);
+
+            std::optional<T> value;
+            if(element->type == JSONNodeType::OBJECT)
+            {
+                JSONNode* entry = FindEntry(element, key, length, name_hash);
+                if(entry) value = ColumnValue<T>(entry);
+            }
+
+            if(!value)
+            {
+                column.values.emplace_back();
+                continue;
+            }
+
+            column.values.push_back(*value);
+            column.validity.back() |= std::uint64_t{ 1 } << (index % 64);
+            column.valid_count++;
+        }
+
+        return column;
     }
 }
 
+template<typename T>
+JSONColumn<T> JSON::extractColumn(const char* key)
+{
+    if(!isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::ARRAY)
+        throw json::invalid_node_type(JSONNodeType::ARRAY, this->getType());
+
+    return ExtractColumn<T>(this->node, key, strlen(key), 0);
+}
+
+template<typename T>
+JSONColumn<T> JSON::extractColumn(const JSONKey& key)
+{
+    if(!isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::ARRAY)
+        throw json::invalid_node_type(JSONNodeType::ARRAY, this->getType());
+
+    return ExtractColumn<T>(this->node, key.data, key.length, CPPJP::FoldKeyHash(key.hash));
+}
+
+template JSONColumn<double> JSON::extractColumn<double>(const char* key);
+template JSONColumn<std::int64_t> JSON::extractColumn<std::int64_t>(const char* key);
+template JSONColumn<std::string_view> JSON::extractColumn<std::string_view>(const char* key);
+template JSONColumn<double> JSON::extractColumn<double>(const JSONKey& key);
+template JSONColumn<std::int64_t> JSON::extractColumn<std::int64_t>(const JSONKey& key);
+template JSONColumn<std::string_view> JSON::extractColumn<std::string_view>(const JSONKey& key);
+
 std::string JSON::asPrintable() const
 {
     if(!isValid()) throw json::bad_node_access();
@@ -380,7 +624,7 @@ std::string JSON::asPrintable() const
                         break;
 
                     case JSONNodeType::NUMBER:
-                        out += current_node->string_data; // name: str_data
+                        out += NumberText(current_node); // name: str_data
                         break;
 
                     case JSONNodeType::ARRAY:
@@ -411,10 +655,13 @@ std::string JSON::asPrintable() const
         } break;
 
         case JSONNodeType::STRING:
-        case JSONNodeType::NUMBER:
             out += this->node->string_data;
             break;
 
+        case JSONNodeType::NUMBER:
+            out += NumberText(this->node);
+            break;
+
         case JSONNodeType::TRUE:
         case JSONNodeType::FALSE:
         case JSONNodeType::JNULL:
@@ -425,20 +672,168 @@ std::string JSON::asPrintable() const
     return out;
 }
 
+void JSON::setString(const std::string& value)
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    while(this->node->child)
+        CPPJP::FreeNode(CPPJP::DetachNode(this->node->child));
+
+    CPPJP::TouchNode(this->node);
+    this->node->type = JSONNodeType::STRING;
+    this->node->string_data.clear();
+    CPPJP::EscapeString(value.data(), value.size(), this->node->string_data);
+
+    if(this->node->string_data.size() == value.size())
+    {
+        // Nothing needed escaping
+        this->node->flags = 0;
+    }
+    else
+    {
+        this->node->flags = NODE_HAS_ESCAPES | NODE_DECODED;
+        NodeExtra(this->node).decoded_data = value;
+    }
+}
+
+namespace
+{
+    /*
+        Turns a node into a number whose value is held in binary, the caller stores the value.
+        @param kind One of NODE_INT64, NODE_UINT64 or NODE_DOUBLE.
+    */
+    void MakeBinaryNumber(JSONNode* node, std::uint16_t kind)
+    {
+        while(node->child)
+            CPPJP::FreeNode(CPPJP::DetachNode(node->child));
+
+        CPPJP::TouchNode(node);
+        node->type = JSONNodeType::NUMBER;
+        node->string_data.clear();
+        node->flags = kind;
+    }
+}
+
+void JSON::setInt64(std::int64_t value)
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    MakeBinaryNumber(this->node, NODE_INT64);
+    this->node->number.int64 = value;
+}
+
+void JSON::setUint64(std::uint64_t value)
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    MakeBinaryNumber(this->node, NODE_UINT64);
+    this->node->number.uint64 = value;
+}
+
+void JSON::setDouble(double value)
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    MakeBinaryNumber(this->node, NODE_DOUBLE);
+    this->node->number.real = value;
+
+    // JSON has no representation for infinities and NaN
+    if(!std::isfinite(value))
+    {
+        this->node->type = JSONNodeType::JNULL;
+        this->node->flags = 0;
+    }
+}
+
+void JSON::append(JSON&& child)
+{
+    if(!isValid() || !child.isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::ARRAY && this->node->type != JSONNodeType::OBJECT)
+        throw json::invalid_node_type({ JSONNodeType::ARRAY, JSONNodeType::OBJECT }, this->getType());
+
+    JSON owned = child.detach();
+    if(!owned.isOwning()) throw json::bad_node_access();
+
+    CPPJP::AppendNode(this->node, owned.release());
+}
+
+void JSON::append(const char* name, JSON&& child)
+{
+    if(!isValid() || !child.isValid()) throw json::bad_node_access();
+    if(this->node->type != JSONNodeType::OBJECT)
+        throw json::invalid_node_type(JSONNodeType::OBJECT, this->getType());
+
+    JSON owned = child.detach();
+    if(!owned.isOwning()) throw json::bad_node_access();
+
+    owned.node->name = name;
+    owned.node->name_hash = CPPJP::NameHash(owned.node->name);
+    CPPJP::AppendNode(this->node, owned.release());
+}
+
+void JSON::applyMergePatch(const JSON& patch)
+{
+    if(!isValid() || !patch.isValid()) throw json::bad_node_access();
+
+    CPPJP::MergePatch(this->node, patch.node, false);
+}
+
+void JSON::applyMergePatch(JSON&& patch)
+{
+    if(!isValid() || !patch.isValid()) throw json::bad_node_access();
+
+    // Only a patch that owns its tree may have nodes taken from it
+    CPPJP::MergePatch(this->node, patch.node, patch.isOwning());
+}
+
 void JSON::writeOut(std::string& out_buf) const { CPPJP::WriteJson(this->node, out_buf); }
+void JSON::writeOut(std::string& out_buf, std::string_view source) const { CPPJP::WriteJson(this->node, out_buf, source); }
+
+std::uint64_t JSON::hash() const
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    return CPPJP::HashNode(this->node);
+}
+
+bool JSON::deepEquals(const JSON& other) const
+{
+    if(!isValid() || !other.isValid()) throw json::bad_node_access();
+
+    return CPPJP::NodesEqual(this->node, other.node);
+}
+
+size_t JSON::memoryUsage() const
+{
+    if(!isValid()) throw json::bad_node_access();
+
+    return CPPJP::MemoryUsage(this->node);
+}
 
 namespace
 {
     void _CopyNodeData(JSONNode* dest, JSONNode* src)
     {
         dest->name = src->name;
+        dest->name_hash = src->name_hash;
         dest->type = src->type;
         dest->string_data = src->string_data;
+        dest->flags = src->flags & ~(NODE_DECODED | NODE_SOURCE_CLEAN | NODE_CHECKPOINT); // The copy decodes again when it is read, and has no source span
+        dest->hash = src->hash;
+        dest->number = src->number;
 
         dest->parent = nullptr;
         dest->next = nullptr;
         dest->previous = nullptr;
         dest->child = nullptr;
+
+        CPPJP_STAT(
+            stats->nodes_cloned++;
+            stats->allocations += 1 + IsHeapAllocated(dest->name) + IsHeapAllocated(dest->string_data);
+            stats->allocated_bytes += sizeof(JSONNode);
+            if(IsHeapAllocated(dest->name)) stats->allocated_bytes += dest->name.capacity() + 1;
+            if(IsHeapAllocated(dest->string_data)) stats->allocated_bytes += dest->string_data.capacity() + 1;
+        );
     }
 }
 
@@ -447,6 +842,8 @@ namespace CPPJP
     JSONNode* CloneNode(JSONNode* node)
     {
         if(!node) return nullptr;
+        CPPJP_STAT_TIMER(clone_ns);
+
         JSONNode* copy = new JSONNode{};
         _CopyNodeData(copy, node);
 
@@ -496,8 +893,45 @@ namespace CPPJP
         return copy;
     }
 
+    void TouchNode(JSONNode* node)
+    {
+        // A cached hash implies cached hashes below it, and a modified node modified
+        // ancestors, so the walk can stop at the first ancestor with neither flag
+        while(node && (node->flags & (NODE_HASHED | NODE_SOURCE_CLEAN)))
+        {
+            node->flags &= ~(NODE_HASHED | NODE_SOURCE_CLEAN);
+            node = node->parent;
+        }
+    }
+
+    void AppendNode(JSONNode* parent, JSONNode* node)
+    {
+        TouchNode(parent);
+        DropSourceSpan(node);
+
+        node->parent = parent;
+        node->next = nullptr;
+
+        if(!parent->child)
+        {
+            node->previous = nullptr;
+            parent->child = node;
+            return;
+        }
+
+        JSONNode* last = parent->child;
+        while(last->next) last = last->next;
+
+        last->next = node;
+        node->previous = last;
+    }
+
     JSONNode* DetachNode(JSONNode* node)
     {
+        TouchNode(node->parent);
+        DropSourceSpan(node);
+        if(node->parent) DropCheckpoints(node->parent);
+
         // Detach the node
         if(node->previous)
             node->previous->next = node->next;
@@ -515,15 +949,21 @@ namespace CPPJP
 
     void FreeNode(JSONNode* node)
     {
+        CPPJP_STAT_TIMER(free_ns);
+
         // Check for child first then for next node
 
         JSONNode* current_node = node;
         JSONNode* next_node; // Initialise a pointer variable for the next node to move onto
 
+        if(current_node->parent) DropCheckpoints(current_node->parent);
+
         // First check if the current node has a next node
         // And if so then make it the next node of the previous node
         if(current_node->next)
         {
+            if(SourceOffset(current_node)) NodeExtra(current_node->next).source_offset += SourceOffset(current_node);
+
             if(current_node->previous)
             {
                 current_node->previous->next = current_node->next;
@@ -568,6 +1008,7 @@ namespace CPPJP
                 if(node->parent && node->parent->child == node)
                     node->parent->child = nullptr;
 
+                CPPJP_STAT(stats->nodes_freed++);
                 delete current_node;
                 node = nullptr;
                 return;
@@ -585,10 +1026,12 @@ namespace CPPJP
             else
             {
                 // If we have no previous and no parent nodes we are at the root node which can now be safely deleted
+                CPPJP_STAT(stats->nodes_freed++);
                 delete current_node;
-                node = nullptr;
+                return;
             }
 
+            CPPJP_STAT(stats->nodes_freed++);
             delete current_node;
             current_node = next_node;
         }
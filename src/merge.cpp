@@ -0,0 +1,135 @@
+#include <vector>
+#include "cppjp.hpp"
+#include "standalone.hpp"
+
+/*
+    JSON Merge Patch (RFC 7386) applied in place.
+
+    The patch and the target are walked together and only the members named by the patch are
+    touched, so the work done is proportional to the patch rather than to the target. When the
+    patch may be consumed its nodes are moved into the target instead of being copied.
+*/
+
+namespace
+{
+    /*
+        Frees the children of a node and empties its string data.
+    */
+    void ClearValue(JSONNode* node)
+    {
+        while(node->child)
+            CPPJP::FreeNode(CPPJP::DetachNode(node->child));
+
+        node->string_data.clear();
+        node->flags = 0;
+    }
+
+    /*
+        Replaces the value of target with the value of source. target keeps its name and its place
+        in the tree.
+        @param move If ```true``` the value and children of source are moved rather than copied.
+    */
+    void AssignValue(JSONNode* target, JSONNode* source, bool move)
+    {
+        CPPJP::TouchNode(target);
+        ClearValue(target);
+
+        target->type = source->type;
+        target->hash = source->hash;
+        target->number = source->number;
+
+        if(move)
+        {
+            CPPJP::TouchNode(source);
+            target->string_data.swap(source->string_data);
+            if(source->extra) NodeExtra(target).decoded_data.swap(source->extra->decoded_data);
+            target->flags = source->flags & ~(NODE_SOURCE_CLEAN | NODE_CHECKPOINT);
+
+            DropCheckpoints(source);
+            target->child = source->child;
+            source->child = nullptr;
+            for(JSONNode* child = target->child; child; child = child->next)
+                child->parent = target;
+
+            // The moved children were positioned in the patch's source
+            if(target->child) DropSourceSpan(target->child);
+
+            return;
+        }
+
+        target->string_data = source->string_data;
+        target->flags = source->flags & ~(NODE_DECODED | NODE_SOURCE_CLEAN | NODE_CHECKPOINT);
+
+        JSONNode* last = nullptr;
+        for(JSONNode* child = source->child; child; child = child->next)
+        {
+            JSONNode* copy = CPPJP::CloneNode(child);
+            copy->parent = target;
+            copy->previous = last;
+
+            if(last) last->next = copy;
+            else target->child = copy;
+
+            last = copy;
+        }
+    }
+}
+
+void CPPJP::MergePatch(JSONNode* target, JSONNode* patch, bool move)
+{
+    if(patch->type != JSONNodeType::OBJECT)
+    {
+        AssignValue(target, patch, move);
+        return;
+    }
+
+    std::vector<std::pair<JSONNode*, JSONNode*>> pending{ { target, patch } };
+
+    while(!pending.empty())
+    {
+        auto [target_object, patch_object] = pending.back();
+        pending.pop_back();
+
+        // Patching anything but an object replaces it with an object
+        if(target_object->type != JSONNodeType::OBJECT)
+        {
+            TouchNode(target_object);
+            ClearValue(target_object);
+            target_object->type = JSONNodeType::OBJECT;
+        }
+
+        JSONNode* member = patch_object->child;
+        while(member)
+        {
+            JSONNode* next_member = member->next; // member may be moved out of the patch
+            JSONNode* existing = FindEntry(target_object, member->name.data(), member->name.size(), member->name_hash);
+
+            if(member->type == JSONNodeType::JNULL)
+            {
+                if(existing) FreeNode(DetachNode(existing));
+            }
+            else if(member->type == JSONNodeType::OBJECT)
+            {
+                if(!existing)
+                {
+                    // Merged into an empty object so that nulls in the patch are dropped
+                    existing = new JSONNode{};
+                    existing->name = member->name;
+                    existing->name_hash = member->name_hash;
+                    existing->type = JSONNodeType::OBJECT;
+                    AppendNode(target_object, existing);
+                }
+
+                pending.emplace_back(existing, member);
+            }
+            else if(existing)
+                AssignValue(existing, member, move);
+            else if(move)
+                AppendNode(target_object, DetachNode(member));
+            else
+                AppendNode(target_object, CloneNode(member));
+
+            member = next_member;
+        }
+    }
+}
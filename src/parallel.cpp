@@ -0,0 +1,292 @@
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "parser.hpp"
+#include "cppjp.hpp"
+#include "thread_pool.hpp"
+#include "scan.hpp"
+#include "standalone.hpp"
+
+/*
+    Parallel parsing of a single document.
+
+    The top level array or object is split at commas that separate its direct members.
+    Finding those commas needs to know, for every byte, whether it is inside a string and
+    how deeply it is nested. This is done in three passes:
+
+    1. Every thread summarises its slice of the input: the number of unescaped quotes and
+       the change in depth under both possible assumptions about the string state at the
+       start of the slice.
+    2. The summaries are combined sequentially to get the true string state and depth at
+       the start of every slice, and each thread then scans forward from its slice start to
+       the first comma at depth 1. These commas become the split points.
+    3. Each chunk of members is parsed on its own thread into a temporary container, and the
+       resulting sibling lists are linked together under the destination node.
+*/
+
+namespace
+{
+    // Slices smaller than this are not worth a thread
+    const size_t min_slice_size = 64 * 1024;
+
+    struct SliceSummary
+    {
+        size_t quotes = 0;              // Unescaped quotes in the slice
+        long depth[2] = { 0, 0 };       // Depth change if the slice starts outside [0] or inside [1] a string
+        long min_depth[2] = { 0, 0 };   // Lowest depth reached, relative to the slice start
+    };
+
+    struct SliceStart
+    {
+        bool in_string;
+        long depth;
+    };
+
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+        JSONNode* container = nullptr;
+        JSONNode* last = nullptr;
+        bool ok = false;
+    };
+
+    /*
+        Checks whether the quote at ch is escaped by counting the backslashes before it.
+    */
+    bool IsEscapedQuote(const char* ch, const char* begin)
+    {
+        size_t backslashes = 0;
+        while(ch > begin && *(ch - 1) == '\\')
+        {
+            backslashes++;
+            ch--;
+        }
+        return backslashes & 1;
+    }
+
+    void SummariseSlice(const char* begin, const char* slice_begin, const char* slice_end, SliceSummary& summary)
+    {
+        bool outside = true; // String state under the "starts outside a string" assumption
+
+        for(const char* ch = slice_begin; ch < slice_end; ch++)
+        {
+            switch(*ch)
+            {
+                case '"':
+                    if(!IsEscapedQuote(ch, begin))
+                    {
+                        summary.quotes++;
+                        outside = !outside;
+                    }
+                    break;
+
+                case '[':
+                case '{':
+                    summary.depth[outside ? 0 : 1]++;
+                    break;
+
+                case ']':
+                case '}':
+                {
+                    int h = outside ? 0 : 1;
+                    summary.depth[h]--;
+                    summary.min_depth[h] = std::min(summary.min_depth[h], summary.depth[h]);
+                } break;
+
+                default:
+                    break;
+            }
+        }
+    }
+
+    /*
+        Scans forward from slice_begin for the first comma separating two top level members.
+        @return The position of the comma, or end if there is none.
+    */
+    const char* FindSplit(const char* begin, const char* slice_begin, const char* end, SliceStart start)
+    {
+        bool in_string = start.in_string;
+        long depth = start.depth;
+
+        for(const char* ch = slice_begin; ch < end; ch++)
+        {
+            if(*ch == '"')
+            {
+                if(!IsEscapedQuote(ch, begin)) in_string = !in_string;
+                continue;
+            }
+
+            if(in_string) continue;
+
+            if(*ch == '[' || *ch == '{') depth++;
+            else if(*ch == ']' || *ch == '}') depth--;
+            else if(*ch == ',' && depth == 1) return ch;
+        }
+
+        return end;
+    }
+
+    /*
+        Divides a budget evenly between chunks, after what the top level container has used.
+        A chunk that runs out of its share fails, and the sequential parse that follows applies
+        the whole budget, so a parallel parse never uses more than the budget in total.
+    */
+    size_t ChunkShare(size_t limit, size_t used, size_t chunk_count)
+    {
+        if(limit == SIZE_MAX) return limit;
+        return limit > used ? (limit - used) / chunk_count : 0;
+    }
+
+    void ParseChunk(Chunk& chunk, JSONNodeType type, const char* begin, const JSONParseOptions& options, size_t chunk_count)
+    {
+        CPPJP::ParseContext ctx;
+        chunk.container = new JSONNode;
+        CPPJP::BeginMembers(ctx, chunk.container, type, begin, options);
+
+        ctx.options.max_nodes = ChunkShare(ctx.options.max_nodes, 1, chunk_count);
+        ctx.options.max_total_bytes = ChunkShare(ctx.options.max_total_bytes, sizeof(JSONNode), chunk_count);
+
+        if(!CPPJP::ParseRange(ctx, chunk.begin, chunk.end)) return;
+
+        // The chunk must end on a complete member of the container
+        if(ctx.state != CPPJP::LEXSTATE::AWAIT_NEXT || ctx.current_node->parent != chunk.container) return;
+
+        chunk.last = ctx.current_node;
+        chunk.ok = true;
+    }
+
+    void AdoptChunk(Chunk& chunk, JSONNode* dest)
+    {
+        for(JSONNode* current_node = chunk.container->child; current_node; current_node = current_node->next)
+            current_node->parent = dest;
+    }
+
+    /*
+        Runs work(i) for every i in [0, count) on the shared thread pool.
+    */
+    void RunOnThreads(size_t count, const std::function<void(size_t)>& work)
+    {
+        CPPJP::SharedPool().run(count, static_cast<unsigned>(count), work);
+    }
+
+    bool ParseSequential(const char* json_str, size_t length, JSONNode* dest, const JSONParseOptions& options, JSONStatus& status)
+    {
+        return CPPJP::ParseDocument(json_str, length, dest, options, status);
+    }
+}
+
+bool CPPJP::ParseJSONParallel(const char* json_str, size_t length, JSONNode* dest, const JSONParseOptions& options, JSONStatus& status)
+{
+    size_t thread_count = options.threads ? options.threads : std::thread::hardware_concurrency();
+    thread_count = std::min(thread_count, length / min_slice_size);
+
+    if(thread_count <= 1)
+        return ParseSequential(json_str, length, dest, options, status);
+
+    // Locate the top level brackets
+    const char* begin = json_str;
+    const char* end = json_str + length;
+
+    const char* open = begin;
+    while(open < end && CPPJP::IsJSONSpace(*open)) open++;
+
+    const char* close = end;
+    while(close > open && CPPJP::IsJSONSpace(*(close - 1))) close--;
+    close--;
+
+    if(open >= close || !((*open == '[' && *close == ']') || (*open == '{' && *close == '}')))
+        return ParseSequential(json_str, length, dest, options, status);
+
+    JSONNodeType type = *open == '[' ? JSONNodeType::ARRAY : JSONNodeType::OBJECT;
+    const char* interior = open + 1;
+    size_t interior_length = close - interior;
+
+    // Pass 1: summarise every slice
+    std::vector<const char*> slice_begin(thread_count + 1);
+    for(size_t i = 0; i < thread_count; i++)
+        slice_begin[i] = interior + interior_length * i / thread_count;
+    slice_begin[thread_count] = close;
+
+    std::vector<SliceSummary> summaries(thread_count);
+    RunOnThreads(thread_count, [&](size_t i){ SummariseSlice(begin, slice_begin[i], slice_begin[i + 1], summaries[i]); });
+
+    // Combine the summaries, the interior starts outside a string at depth 1
+    std::vector<SliceStart> starts(thread_count);
+    SliceStart state = { false, 1 };
+    for(size_t i = 0; i < thread_count; i++)
+    {
+        int h = state.in_string ? 1 : 0;
+        starts[i] = state;
+
+        // The top level container must not be closed before its final bracket
+        if(state.depth + summaries[i].min_depth[h] < 1)
+            return ParseSequential(json_str, length, dest, options, status);
+
+        state.depth += summaries[i].depth[h];
+        if(summaries[i].quotes & 1) state.in_string = !state.in_string;
+    }
+
+    if(state.in_string || state.depth != 1)
+        return ParseSequential(json_str, length, dest, options, status);
+
+    // Pass 2: find the first top level comma in every slice but the first
+    std::vector<const char*> splits(thread_count, close);
+    RunOnThreads(thread_count, [&](size_t i){ if(i) splits[i] = FindSplit(begin, slice_begin[i], close, starts[i]); });
+    splits[0] = interior - 1;
+
+    splits.erase(std::unique(splits.begin(), splits.end()), splits.end());
+
+    std::vector<Chunk> chunks;
+    for(size_t i = 0; i < splits.size(); i++)
+    {
+        const char* chunk_end = i + 1 < splits.size() ? splits[i + 1] : close;
+        if(splits[i] == close) break;
+        chunks.push_back(Chunk{ splits[i] + 1, chunk_end });
+    }
+
+    if(chunks.size() <= 1)
+        return ParseSequential(json_str, length, dest, options, status);
+
+    // Pass 3: parse every chunk
+    RunOnThreads(chunks.size(), [&](size_t i){ ParseChunk(chunks[i], type, begin, options, chunks.size()); });
+
+    bool ok = std::all_of(chunks.begin(), chunks.end(), [](const Chunk& chunk){ return chunk.ok; });
+
+    if(!ok)
+    {
+        for(Chunk& chunk : chunks)
+            if(chunk.container) FreeNode(chunk.container);
+
+        return ParseSequential(json_str, length, dest, options, status);
+    }
+
+    // Stitch the chunks together under dest
+    RunOnThreads(chunks.size(), [&](size_t i){ AdoptChunk(chunks[i], dest); });
+
+    dest->parent = nullptr;
+    dest->type = type;
+    dest->child = chunks.front().container->child;
+
+    for(size_t i = 0; i + 1 < chunks.size(); i++)
+    {
+        JSONNode* next_first = chunks[i + 1].container->child;
+        chunks[i].last->next = next_first;
+        next_first->previous = chunks[i].last;
+    }
+
+    for(Chunk& chunk : chunks)
+    {
+        chunk.container->child = nullptr;
+        delete chunk.container;
+    }
+
+    // The members carry absolute offsets until their container is closed
+    if(options.track_source)
+    {
+        NodeExtra(dest).source_offset = open - begin;
+        CloseSourceSpan(dest, close + 1 - begin);
+    }
+
+    return true;
+}
@@ -1,20 +1,131 @@
 #include <string.h>
+#include <tuple>
+#include <vector>
 #include "parser.hpp"
 #include "standalone.hpp"
 #include "cppjp.hpp"
+#include "stats.hpp"
+#include "utf8.hpp"
+#include "scan.hpp"
 
-enum class LEXSTATE
+/*
+    Records an error and its position in ctx.
+    @return Always ```false``` so it can be returned directly.
+*/
+static bool Fail(CPPJP::ParseContext& ctx, JSONError error, const char* at)
+{
+    ctx.status.error = error;
+    ctx.status.offset = ctx.base_offset + (at - ctx.begin);
+    return false;
+}
+
+/*
+    Charges a new node against the node and memory budgets. Called before the node is allocated.
+    @param at The token the node is created for.
+    @return ```false``` with ctx.status set if a budget is exceeded.
+*/
+static bool ChargeNode(CPPJP::ParseContext& ctx, const char* at)
 {
-    SEARCH_VALUE = 0,
-    SEARCH_NAME,
-    SEARCH_OBJECT_CHILD,
-    SEARCH_COLON,
-    AWAIT_NEXT
+    ctx.node_count++;
+    ctx.total_bytes += sizeof(JSONNode);
+
+    if(ctx.node_count > ctx.options.max_nodes)
+    {
+        puts("Maximum number of nodes exceeded");
+        return Fail(ctx, JSONError::TOO_MANY_NODES, at);
+    }
+
+    if(ctx.total_bytes > ctx.options.max_total_bytes)
+    {
+        puts("Memory budget exceeded");
+        return Fail(ctx, JSONError::MEMORY_BUDGET_EXCEEDED, at);
+    }
+
+    return true;
+}
+
+/*
+    Charges the text of a name, string or number against the memory budget.
+*/
+static bool ChargeText(CPPJP::ParseContext& ctx, size_t length, const char* at)
+{
+    ctx.total_bytes += length;
+
+    if(ctx.total_bytes > ctx.options.max_total_bytes)
+    {
+        puts("Memory budget exceeded");
+        return Fail(ctx, JSONError::MEMORY_BUDGET_EXCEEDED, at);
+    }
+
+    return true;
+}
+
+/*
+    Replaces limits of 0, meaning no limit, with SIZE_MAX so each check is a single compare.
+*/
+static void NormaliseLimits(JSONParseOptions& options)
+{
+    for(size_t* limit : { &options.max_depth, &options.max_nodes, &options.max_string_length, &options.max_total_bytes })
+        if(!*limit) *limit = SIZE_MAX;
+}
+
+/*
+    Classes of the bytes the lexer dispatches on: each byte maps to the token it starts, so the
+    main loop makes one table lookup per token instead of testing every token kind in turn.
+    Whitespace is exactly the four characters RFC 8259 allows.
+*/
+enum class CharClass : std::uint8_t
+{
+    INVALID = 0,
+    SPACE,
+    STRING,
+    OBJECT_OPEN,
+    OBJECT_CLOSE,
+    ARRAY_OPEN,
+    ARRAY_CLOSE,
+    COMMA,
+    COLON,
+    NUMBER,
+    TRUE,
+    FALSE,
+    JNULL
 };
 
+struct CharClassTable
+{
+    CharClass classes[256];
+
+    constexpr CharClassTable() : classes()
+    {
+        classes[static_cast<unsigned char>(' ')] = CharClass::SPACE;
+        classes[static_cast<unsigned char>('\t')] = CharClass::SPACE;
+        classes[static_cast<unsigned char>('\n')] = CharClass::SPACE;
+        classes[static_cast<unsigned char>('\r')] = CharClass::SPACE;
+        classes[static_cast<unsigned char>('"')] = CharClass::STRING;
+        classes[static_cast<unsigned char>('{')] = CharClass::OBJECT_OPEN;
+        classes[static_cast<unsigned char>('}')] = CharClass::OBJECT_CLOSE;
+        classes[static_cast<unsigned char>('[')] = CharClass::ARRAY_OPEN;
+        classes[static_cast<unsigned char>(']')] = CharClass::ARRAY_CLOSE;
+        classes[static_cast<unsigned char>(',')] = CharClass::COMMA;
+        classes[static_cast<unsigned char>(':')] = CharClass::COLON;
+        classes[static_cast<unsigned char>('-')] = CharClass::NUMBER;
+        for(char digit = '0'; digit <= '9'; digit++)
+            classes[static_cast<unsigned char>(digit)] = CharClass::NUMBER;
+        classes[static_cast<unsigned char>('t')] = CharClass::TRUE;
+        classes[static_cast<unsigned char>('f')] = CharClass::FALSE;
+        classes[static_cast<unsigned char>('n')] = CharClass::JNULL;
+    }
+};
+
+static constexpr CharClassTable char_classes;
+
+static inline CharClass ClassOf(char ch)
+{
+    return char_classes.classes[static_cast<unsigned char>(ch)];
+}
+
 /*
     Checks if the supplied character is a valid escaped character.
-    Does not check for the 4 hex digits after u as per the json spec.
     @param ch The character to check
     @return ```true``` if ch is a valid escaped character ```false``` otehrwise
 */
@@ -33,358 +144,688 @@ static bool IsEscaped(char ch)
 }
 
 /*
-    Stores string defined between two " marks in the output_buffer.
+    Stores the string defined between two " marks in the output_buffer, exactly as written in
+    the source with its escape sequences intact. Decoding is left to the first reader.
     current_char should point to the opening ".
     The returned pointer will point to the closing ".
     @param ch The opening ```"``` from which to start the string.
+    @param end One past the last character that may be read.
     @param out_buf The output buffer to which the string will be saved to.
-    @return A pointer to the closing ```"```.
+    @param has_escapes Set to whether the string contains any escape sequences.
+    @param ctx The parse context in which errors are recorded.
+    @return A pointer to the closing ```"```, or ```nullptr``` on error.
 */
-static const char* ParseString(const char* ch, std::string& out_buf)
+static const char* ParseString(const char* ch, const char* end, std::string& out_buf, bool& has_escapes, CPPJP::ParseContext& ctx)
 {
-    // This function still needs fixing to correctly parse escaped characters and error with illegal characters (eg. linfeed or carrage return)
-    out_buf.clear();
+    const char* opening = ch;
+    has_escapes = false;
     ch++;
-    while(*ch != '"')
+
+    while(true)
     {
-        switch(*ch)
+        // Skip the run of plain characters in bulk
+        ch = CPPJP::FindStringSpecial(ch, end);
+
+        if(ch >= end)
         {
-            case '\n':
-                puts("Illegal newline character encountered while parsing a string");
+            if(static_cast<size_t>(end - opening - 1) > ctx.options.max_string_length)
+            {
+                puts("Maximum string length exceeded");
+                Fail(ctx, JSONError::STRING_TOO_LONG, opening);
                 return nullptr;
+            }
+
+            // The rest of the string has not been read yet, the caller resumes from the opening quote
+            if(ctx.partial_input) return nullptr;
+
+            puts("Unterminated string encountered");
+            Fail(ctx, JSONError::UNEXPECTED_END, ch);
+            return nullptr;
+        }
+
+        if(*ch == '"')
+            break;
+
+        if(*ch != '\\')
+        {
+            if(*ch == '\n') puts("Illegal newline character encountered while parsing a string");
+            else if(*ch == '\r') puts("Illegal carridge return character encountered while parsing a string");
+            else puts("Illegal control character encountered while parsing a string");
+            Fail(ctx, JSONError::INVALID_STRING, ch);
+            return nullptr;
+        }
 
-            case '\r':
-                puts("Illegal carridge return character encountered while parsing a string");
+        const char* escape = ch;
+        ch++;
+        if(ch >= end)
+            continue;
+        if(!IsEscaped(*ch))
+        {
+            printf("The character '%c' is not a valid escaped character.\n", *ch);
+            Fail(ctx, JSONError::INVALID_ESCAPE, escape);
+            return nullptr;
+        }
+        if(*ch == 'u')
+        {
+            if(end - ch < 5)
+            {
+                ch = end;
+                continue;
+            }
+            if(!CPPJP::IsHexDigit(ch[1]) || !CPPJP::IsHexDigit(ch[2]) || !CPPJP::IsHexDigit(ch[3]) || !CPPJP::IsHexDigit(ch[4]))
+            {
+                puts("Expected 4 hex digits after \\u");
+                Fail(ctx, JSONError::INVALID_ESCAPE, escape);
                 return nullptr;
+            }
+            ch += 4;
+        }
+        ch++;
+        has_escapes = true;
+    }
 
-            case '\\':
-                out_buf.push_back(*ch);
-                ch++;
-                if(!IsEscaped(*ch))
-                {
-                    printf("The character '%c' is not a valid escaped character.\n", *ch);
-                    return nullptr;
-                }
-                out_buf.push_back(*ch);
-                ch++;
-                break;
+    size_t length = ch - opening - 1;
+    if(length > ctx.options.max_string_length)
+    {
+        puts("Maximum string length exceeded");
+        Fail(ctx, JSONError::STRING_TOO_LONG, opening);
+        return nullptr;
+    }
+    if(!ChargeText(ctx, length, opening)) return nullptr;
 
-            default:
-                out_buf.push_back(*ch);
-                ch++;
-                break;
+    if(ctx.options.validate_utf8)
+    {
+        const char* invalid = CPPJP::FindInvalidUTF8(opening + 1, ch);
+        if(invalid != ch)
+        {
+            puts("Invalid UTF-8 encountered while parsing a string");
+            Fail(ctx, JSONError::INVALID_UTF8, invalid);
+            return nullptr;
         }
     }
+
+    out_buf.assign(opening + 1, ch);
     return ch;
 }
 
 /*
-    Function to check if a string of characters starting at ```current_char_ptr```
-    matches the characters in ```match_string```
-    @param cur_ch A pointer to the current character to start the matching from
-    @param match_str The string to match
-    @return The number of characters matched if successful, 0 otherwise.
+    Checks the four characters at ch against word with a single comparison.
+    @param ch The first character to compare
+    @param end One past the last character that may be read
+    @param word The four characters to match
+    @return ```true``` if all four characters are present and match, ```false``` otherwise.
 */
-static size_t MatchString(const char* cur_ch, const char* match_str)
+static inline bool MatchWord(const char* ch, const char* end, const char* word)
 {
-    size_t string_length = strlen(match_str);
-    for(size_t i = 0; i < string_length; i++)
-    {
-        if(!*cur_ch) return 0; // This check is technically redundant as if a null terminator is encountered it will not match and the function wil exit
-        if(cur_ch[i] != match_str[i]) return 0;
-    }
-    return string_length;
+    if(end - ch < 4) return false;
+
+    std::uint32_t text;
+    std::uint32_t expected;
+    memcpy(&text, ch, sizeof(text));
+    memcpy(&expected, word, sizeof(expected));
+    return text == expected;
 }
 
 /*
-    Returns pointer pointing to next non whitespace character
+    Bounded isdigit, returns ```false``` once ```s``` reaches ```end```
 */
-static const char* JumpSpace(const char* current_char)
+static inline bool IsDigitAt(const char* s, const char* end)
 {
-    current_char++; // Should always move at least 1 character
-    while(isspace(*current_char)) current_char++; // Maybe implement a custom is space function to comply with JSON standard
-    return current_char;
+    return s < end && CPPJP::IsDigit(*s);
 }
 
 /**
  * Checks if the sequence of characters starting at `s` forms a number.
  * @param s Character to start check from
+ * @param end One past the last character that may be read
  * @return Number of characters representing the number if successful.
  *         0 if NaN.
  *         -1 on error.
  */
-static int ScanNumber(const char* s)
+static int ScanNumber(const char* s, const char* end)
 {
     const char* start = s;
 
     // If the current character is a minus, add it to the buffer and move to next character
-    if(*s == '-'){ s++; }
+    if(s < end && *s == '-'){ s++; }
     
     // Check if the current character is is 0-9
-    if(!isdigit(*s)) return 0;
+    if(!IsDigitAt(s, end)) return 0;
 
     s++;
 
     // Check last character
     if(*(s - 1) != '0')         // Checks if the previous character was a zero
-        while(isdigit(*s))
+        while(IsDigitAt(s, end))
             s++;
 
     // Next search for fraction
-    if(*s == '.')
+    if(s < end && *s == '.')
     {
         s++;
 
         // There needs to be at least one digit after the '.'
-        if(!isdigit(*s))
+        if(!IsDigitAt(s, end))
         {
             puts("Number parsing error, no digits after decimal point");
             return -1;
         }
 
-        while(isdigit(*s))
+        while(IsDigitAt(s, end))
             s++;
     }
 
     // Then exponent
-    if(*s == 'e' || *s == 'E')
+    if(s < end && (*s == 'e' || *s == 'E'))
     {
         s++;
 
-        if(*s == '+' || *s == '-')
+        if(s < end && (*s == '+' || *s == '-'))
             s++;
 
         // There needs to be at least one digit
-        if(!isdigit(*s))
+        if(!IsDigitAt(s, end))
         {
             puts("Number parsing error, no digits after exponent");
             return -1;
         }
 
-        while(isdigit(*s))
+        while(IsDigitAt(s, end))
             s++;
     }
 
     return s - start;
 }
 
-bool CPPJP::ParseJSON(const char* ch, JSONNode* dest)
+void CPPJP::CloseSourceSpan(JSONNode* container, size_t end)
 {
-    // Return early if the passed in pointer is null
-    if(dest == nullptr) return false;
+    JSONNodeExtra& span = NodeExtra(container);
+    span.source_length = end - span.source_offset;
+    container->flags |= NODE_SOURCE_CLEAN;
 
-    dest->parent = nullptr;
-    JSONNode* current_node = dest;
-    LEXSTATE state = LEXSTATE::SEARCH_VALUE;
-    std::string string_buffer;
-    bool child_is_first = false;
+    size_t previous = span.source_offset;
+    for(JSONNode* child = container->child; child; child = child->next)
+    {
+        JSONNodeExtra& child_span = NodeExtra(child);
+        size_t absolute = child_span.source_offset;
+        child_span.source_offset = absolute - previous;
+        previous = absolute;
+    }
+}
 
-    while(*ch)
+void CPPJP::BeginParse(ParseContext& ctx, JSONNode* root, const char* begin, const JSONParseOptions& options)
+{
+    root->parent = nullptr;
+    root->flags = 0;
+    ctx.begin = begin;
+    ctx.base_offset = 0;
+    ctx.partial_input = false;
+    ctx.resume = nullptr;
+    ctx.options = options;
+    NormaliseLimits(ctx.options);
+    ctx.status = JSONStatus{};
+    ctx.depth = 0;
+    ctx.node_count = 1;
+    ctx.total_bytes = sizeof(JSONNode);
+    ctx.root = root;
+    ctx.current_node = root;
+    ctx.state = LEXSTATE::SEARCH_VALUE;
+    ctx.string_buffer.clear();
+    ctx.child_is_first = false;
+}
+
+void CPPJP::BeginMembers(ParseContext& ctx, JSONNode* container, JSONNodeType type, const char* begin, const JSONParseOptions& options)
+{
+    container->parent = nullptr;
+    ctx.begin = begin;
+    ctx.base_offset = 0;
+    ctx.partial_input = false;
+    ctx.resume = nullptr;
+    ctx.options = options;
+    NormaliseLimits(ctx.options);
+    ctx.status = JSONStatus{};
+    ctx.depth = 1;
+    ctx.node_count = 0;
+    ctx.total_bytes = 0;
+    container->type = type;
+    ctx.root = container;
+    ctx.string_buffer.clear();
+
+    if(type == JSONNodeType::ARRAY)
     {
-        while(isspace(*ch)) { ch++; } // Maybe implement a custom is space function to comply with JSON standard
+        // Behave as if the opening [ has just been consumed
+        ctx.node_count++;
+        ctx.total_bytes += sizeof(JSONNode);
+        container->child = new JSONNode;
+        container->child->parent = container;
+        ctx.current_node = container->child;
+        ctx.state = LEXSTATE::SEARCH_VALUE;
+        ctx.child_is_first = false;
+    }
+    else
+    {
+        // Behave as if the opening { has just been consumed
+        ctx.current_node = container;
+        ctx.state = LEXSTATE::SEARCH_OBJECT_CHILD;
+        ctx.child_is_first = true;
+    }
+}
 
-        if(*ch == '"') // Encountered string
-        {
-            // Check if we are looking for a value or name, if neither then error
-            switch(state)
-            {
-                case LEXSTATE::SEARCH_VALUE:
-                    ch = ParseString(ch, string_buffer);           // Update current character position
-                    current_node->type = JSONNodeType::STRING;      // Set the correct node type
-                    current_node->string_data = string_buffer;      // Set current nodes string data to the extracted string
-                    state = LEXSTATE::AWAIT_NEXT;
-                    break;
-                case LEXSTATE::SEARCH_OBJECT_CHILD:
-                    ch = ParseString(ch, string_buffer);           // Update current character position
-                    state = LEXSTATE::SEARCH_COLON;                 // Update state to search for a colon
-                    break;
-                default:
-                    puts("Unexpected string token");
-                    return false;
-                    break;
-            }
-            // ch can be made null if ParseString throws an error
-            if(!ch)
-                return false;
-        }
+bool CPPJP::ParseRange(ParseContext& ctx, const char* ch, const char* end)
+{
+    JSONNode* current_node = ctx.current_node;
+    LEXSTATE state = ctx.state;
+    std::string& string_buffer = ctx.string_buffer;
+    bool child_is_first = ctx.child_is_first;
 
-        int size = ScanNumber(ch);
+    // Saves the lexer state when a token runs into the end of partial input
+    auto suspend = [&](const char* token_start)
+    {
+        ctx.current_node = current_node;
+        ctx.state = state;
+        ctx.child_is_first = child_is_first;
+        ctx.resume = token_start;
+        return true;
+    };
+
+    // Fails unless a value may start here
+    auto expect_value = [&](const char* at)
+    {
+        if(state == LEXSTATE::SEARCH_VALUE) return true;
 
-        if(size) // Encountered number
+        if(state == LEXSTATE::AWAIT_NEXT && current_node == ctx.root)
         {
-            if(size == -1)
-                return false;
-            
-            current_node->type = JSONNodeType::NUMBER;
-            current_node->string_data = std::string(ch, size);
-            ch += size; // Advance the current character by the number of items traversed
-            state = LEXSTATE::AWAIT_NEXT;
+            puts("Unexpected characters after the end of the document");
+            return Fail(ctx, JSONError::TRAILING_CHARACTERS, at);
         }
 
-        if(*ch == '{') // Encountered object
-        {
-            current_node->type = JSONNodeType::OBJECT;
-            state = LEXSTATE::SEARCH_OBJECT_CHILD;
-            child_is_first = true;
-        }
+        puts("Unexpected value token");
+        return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, at);
+    };
+
+    // Fails unless the bracket at ch closes an open container of the given type after a complete member
+    auto expect_close = [&](const char* at, JSONNodeType type)
+    {
+        if(state == LEXSTATE::AWAIT_NEXT && current_node != ctx.root && current_node->parent->type == type) return true;
 
-        if(*ch == '[') // Encountered Array
+        puts("Unexpected closing bracket");
+        bool after_root = state == LEXSTATE::AWAIT_NEXT && current_node == ctx.root;
+        return Fail(ctx, after_root ? JSONError::TRAILING_CHARACTERS : JSONError::UNEXPECTED_CHARACTER, at);
+    };
+
+    // Records the start of a value, and the end of a scalar
+    const bool track_source = ctx.options.track_source;
+    auto mark_value = [&](const char* start, const char* value_end)
+    {
+        JSONNodeExtra& span = NodeExtra(current_node);
+        span.source_offset = ctx.base_offset + (start - ctx.begin);
+        span.source_length = value_end - start;
+        current_node->flags |= NODE_SOURCE_CLEAN;
+    };
+
+    ctx.resume = nullptr;
+
+    while(ch < end)
+    {
+        switch(ClassOf(*ch))
         {
-            if(state != LEXSTATE::SEARCH_VALUE)
+            case CharClass::SPACE:
+                do ch++; while(ch < end && ClassOf(*ch) == CharClass::SPACE);
+                continue;
+
+            case CharClass::STRING:
             {
-                puts("Invalid state @ array start");
-                return false;
-            }
+                // Check if we are looking for a value or name, if neither then error
+                const char* token_start = ch;
+                bool has_escapes;
+
+                switch(state)
+                {
+                    case LEXSTATE::SEARCH_VALUE:
+                        ch = ParseString(ch, end, current_node->string_data, has_escapes, ctx); // Extract straight into the nodes string data
+                        if(!ch)
+                            return ctx.status.ok() ? suspend(token_start) : false; // No error means the string continues in the next range
+                        current_node->type = JSONNodeType::STRING;      // Set the correct node type
+                        current_node->flags = has_escapes ? NODE_HAS_ESCAPES : 0;
+                        if(track_source) mark_value(token_start, ch + 1);
+                        state = LEXSTATE::AWAIT_NEXT;
+                        break;
+
+                    case LEXSTATE::SEARCH_OBJECT_CHILD:
+                        ch = ParseString(ch, end, string_buffer, has_escapes, ctx); // Update current character position
+                        if(!ch)
+                            return ctx.status.ok() ? suspend(token_start) : false;
+                        if(has_escapes)
+                        {
+                            // Names are kept decoded so that lookups and comparisons see the text they stand for
+                            ctx.escaped_name.swap(string_buffer);
+                            string_buffer.clear();
+                            CPPJP::DecodeString(ctx.escaped_name.data(), ctx.escaped_name.size(), string_buffer);
+                        }
+                        state = LEXSTATE::SEARCH_COLON;                 // Update state to search for a colon
+                        break;
+
+                    default:
+                        puts("Unexpected string token");
+                        return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
+                }
+            } break;
 
-            // Mark the current node as an array type
-            current_node->type = JSONNodeType::ARRAY;
-            
-            // If the nextd character closes the array dont allocate memory and just continue
-            if(*JumpSpace(ch) == ']')
+            case CharClass::NUMBER:
             {
-                // printf(" with no children\n");
-                ch = JumpSpace(ch);
-                ch++; // Needs to be incremented here
+                // A number reaching the end of partial input may continue in the next range
+                if(ctx.partial_input)
+                {
+                    const char* run = ch;
+                    while(run < end && (CPPJP::IsDigit(*run) || *run == '-' || *run == '+' || *run == '.' || *run == 'e' || *run == 'E')) run++;
+                    if(run == end) return suspend(ch);
+                }
+
+                int size = ScanNumber(ch, end);
+                if(!size)
+                    return Fail(ctx, JSONError::INVALID_NUMBER, ch);
+                if(!expect_value(ch))
+                    return false;
+                if(size == -1)
+                    return Fail(ctx, JSONError::INVALID_NUMBER, ch);
+                if(!ChargeText(ctx, size, ch))
+                    return false;
+
+                current_node->type = JSONNodeType::NUMBER;
+                current_node->string_data = std::string(ch, size);
+                if(track_source) mark_value(ch, ch + size);
+                ch += size; // Advance the current character by the number of items traversed
                 state = LEXSTATE::AWAIT_NEXT;
-                continue;
-            }
+            } continue;
 
-            // Allocate memory for its child
-            // List of next node properties that need initialisation: [parent]
-            current_node->child = new JSONNode;             // Allocate memory for new child node
-            current_node->child->parent = current_node;     // Set the childs parent
-            current_node = current_node->child;             // Set the current node to the child
-            state = LEXSTATE::SEARCH_VALUE;
-        }
+            case CharClass::OBJECT_OPEN:
+                if(!expect_value(ch))
+                    return false;
 
-        if(*ch == ']')
-        {
-            if(state == LEXSTATE::AWAIT_NEXT)
-                current_node = current_node->parent;
-            state = LEXSTATE::AWAIT_NEXT;
-        }
+                if(++ctx.depth > ctx.options.max_depth)
+                {
+                    puts("Maximum nesting depth exceeded");
+                    return Fail(ctx, JSONError::NESTING_TOO_DEEP, ch);
+                }
 
-        if(*ch == 't') // Check if the word is true
-        {
-            if(MatchString(ch, "true") != 4)
+                current_node->type = JSONNodeType::OBJECT;
+                if(track_source) mark_value(ch, ch);
+                state = LEXSTATE::SEARCH_OBJECT_CHILD;
+                child_is_first = true;
+                break;
+
+            case CharClass::ARRAY_OPEN:
             {
-                puts("Unexpected token encountered when searching for true");
-                return false;
-            }
+                // An empty array reaching the end of partial input may continue in the next range
+                if(ctx.partial_input && CPPJP::SkipJSONSpace(ch + 1, end) == end)
+                    return suspend(ch);
 
-            current_node->type = JSONNodeType::TRUE;
-            state = LEXSTATE::AWAIT_NEXT;
-        }
+                if(!expect_value(ch))
+                    return false;
 
-        if(*ch == 'f') // Check if the word is false
-        {
-            if(MatchString(ch, "false") != 5)
-            {
-                puts("Unexpected token encountered when searching for false");
-                return false;
-            }
+                if(ctx.depth + 1 > ctx.options.max_depth)
+                {
+                    puts("Maximum nesting depth exceeded");
+                    return Fail(ctx, JSONError::NESTING_TOO_DEEP, ch);
+                }
 
-            current_node->type = JSONNodeType::FALSE;
-            state = LEXSTATE::AWAIT_NEXT;
-        }
+                // Mark the current node as an array type
+                current_node->type = JSONNodeType::ARRAY;
+                if(track_source) mark_value(ch, ch);
 
-        if(*ch == 'n') // Check if the word is null
-        {
-            if(MatchString(ch, "null") != 4)
-            {
-                puts("Unexpected token encountered when searching for null");
-                return false;
-            }
+                // If the nextd character closes the array dont allocate memory and just continue
+                const char* after_space = CPPJP::SkipJSONSpace(ch + 1, end);
+                if(after_space < end && *after_space == ']')
+                {
+                    if(track_source) current_node->extra->source_length = after_space + 1 - ch;
+                    ch = after_space + 1;
+                    state = LEXSTATE::AWAIT_NEXT;
+                    continue;
+                }
 
-            current_node->type = JSONNodeType::JNULL;
-            state = LEXSTATE::AWAIT_NEXT;
-        }
+                if(!ChargeNode(ctx, ch))
+                    return false;
+                ctx.depth++;
+
+                // Allocate memory for its child
+                // List of next node properties that need initialisation: [parent]
+                current_node->child = new JSONNode;             // Allocate memory for new child node
+                current_node->child->parent = current_node;     // Set the childs parent
+                current_node = current_node->child;             // Set the current node to the child
+                state = LEXSTATE::SEARCH_VALUE;
+            } break;
+
+            case CharClass::ARRAY_CLOSE:
+                if(!expect_close(ch, JSONNodeType::ARRAY))
+                    return false;
 
-        if(*ch == '}') // Encountered object end
-        {
-            // The two valid states that this case should be entered under are AWAIT_NEXT or SEACH_OBJECT_CHILD
-            if(state == LEXSTATE::AWAIT_NEXT)
-            {
-                // We are at the end of the current object and should return to parent
                 current_node = current_node->parent;
-            }
-            else if(state != LEXSTATE::SEARCH_OBJECT_CHILD)
-            {
-                puts("Invalid state @ object end");
-                return false;
-            }
-            state = LEXSTATE::AWAIT_NEXT;
-        }
+                ctx.depth--;
+                state = LEXSTATE::AWAIT_NEXT;
+                if(track_source) CloseSourceSpan(current_node, ctx.base_offset + (ch + 1 - ctx.begin));
+                break;
 
-        if(*ch == ',')
-        {
-            if(state != LEXSTATE::AWAIT_NEXT)
-            {
-                printf("Invalid state @ comma [State: %u]\n", static_cast<unsigned int>(state));
-                return false;
-            }
+            case CharClass::TRUE:
+                if(ctx.partial_input && end - ch < 4)
+                    return suspend(ch);
+                if(!expect_value(ch))
+                    return false;
 
-            if(current_node->parent->type == JSONNodeType::OBJECT)
-            {
-                child_is_first = false;
-                state = LEXSTATE::SEARCH_OBJECT_CHILD;
-            }
-            if(current_node->parent->type == JSONNodeType::ARRAY)
-            {
-                // Allocate memory for the next node
-                // List of child properties that need initialisation: [parent, previous_node]
-                current_node->next = new JSONNode;                  // Allocate memory for new child node
-                current_node->next->previous = current_node;        // Set the next nodes previous node
-                current_node->next->parent = current_node->parent;  // Set the next nodes parent
-                current_node = current_node->next;                  // Set the current node to the next node
-                state = LEXSTATE::SEARCH_VALUE;
-            }
-        }
+                if(!MatchWord(ch, end, "true"))
+                {
+                    puts("Unexpected token encountered when searching for true");
+                    return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
+                }
 
-        if(*ch == ':')
-        {
-            if(state != LEXSTATE::SEARCH_COLON)
-            {
-                printf("Invalid state @ colon [State: %u]\n", static_cast<unsigned int>(state));
-                return false;
-            }
+                current_node->type = JSONNodeType::TRUE;
+                if(track_source) mark_value(ch, ch + 4);
+                state = LEXSTATE::AWAIT_NEXT;
+                ch += 4;
+                continue;
 
-            // We know that we are in an object because a colon is not used elsewhere
-            // We should now create a new child node or a next node for the current node based on child_is_first
+            case CharClass::FALSE:
+                if(ctx.partial_input && end - ch < 5)
+                    return suspend(ch);
+                if(!expect_value(ch))
+                    return false;
 
-            // List of child properties that need initialisation: [parent, name, previous_node]
-            if(child_is_first)
-            {
-                current_node->child = new JSONNode;                 // Allocate memory for new child node
-                current_node->child->parent = current_node;         // Set the childs parent
-                current_node = current_node->child;                 // Set the current node to the child
-            }
-            else
-            {
-                current_node->next = new JSONNode;                  // Allocate memory for new next node
-                current_node->next->parent = current_node->parent;  // Set the next nodes parent
-                current_node->next->previous = current_node;        // Set the next nodes previous node
-                current_node = current_node->next;                  // Set the current node to the child
-            }
+                // The leading f has been matched by the dispatch
+                if(!MatchWord(ch + 1, end, "alse"))
+                {
+                    puts("Unexpected token encountered when searching for false");
+                    return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
+                }
+
+                current_node->type = JSONNodeType::FALSE;
+                if(track_source) mark_value(ch, ch + 5);
+                state = LEXSTATE::AWAIT_NEXT;
+                ch += 5;
+                continue;
+
+            case CharClass::JNULL:
+                if(ctx.partial_input && end - ch < 4)
+                    return suspend(ch);
+                if(!expect_value(ch))
+                    return false;
+
+                if(!MatchWord(ch, end, "null"))
+                {
+                    puts("Unexpected token encountered when searching for null");
+                    return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
+                }
+
+                current_node->type = JSONNodeType::JNULL;
+                if(track_source) mark_value(ch, ch + 4);
+                state = LEXSTATE::AWAIT_NEXT;
+                ch += 4;
+                continue;
+
+            case CharClass::OBJECT_CLOSE:
+                // An empty object closes the current node itself, otherwise the current node is its last member
+                if(state != LEXSTATE::SEARCH_OBJECT_CHILD || !child_is_first)
+                {
+                    if(!expect_close(ch, JSONNodeType::OBJECT))
+                        return false;
 
-            current_node->name = string_buffer;                     // Set current nodes name to the extracted string
-            state = LEXSTATE::SEARCH_VALUE;
+                    current_node = current_node->parent;
+                }
+
+                ctx.depth--;
+                if(track_source) CloseSourceSpan(current_node, ctx.base_offset + (ch + 1 - ctx.begin));
+                state = LEXSTATE::AWAIT_NEXT;
+                break;
+
+            case CharClass::COMMA:
+                if(state != LEXSTATE::AWAIT_NEXT)
+                {
+                    printf("Invalid state @ comma [State: %u]\n", static_cast<unsigned int>(state));
+                    return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
+                }
+
+                if(!current_node->parent)
+                {
+                    puts("Unexpected comma outside of an array or object");
+                    return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
+                }
+
+                if(current_node->parent->type == JSONNodeType::OBJECT)
+                {
+                    child_is_first = false;
+                    state = LEXSTATE::SEARCH_OBJECT_CHILD;
+                }
+                else
+                {
+                    if(!ChargeNode(ctx, ch))
+                        return false;
+
+                    // Allocate memory for the next node
+                    // List of child properties that need initialisation: [parent, previous_node]
+                    current_node->next = new JSONNode;                  // Allocate memory for new child node
+                    current_node->next->previous = current_node;        // Set the next nodes previous node
+                    current_node->next->parent = current_node->parent;  // Set the next nodes parent
+                    current_node = current_node->next;                  // Set the current node to the next node
+                    state = LEXSTATE::SEARCH_VALUE;
+                }
+                break;
+
+            case CharClass::COLON:
+                if(state != LEXSTATE::SEARCH_COLON)
+                {
+                    printf("Invalid state @ colon [State: %u]\n", static_cast<unsigned int>(state));
+                    return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
+                }
+
+                // We know that we are in an object because a colon is not used elsewhere
+                // We should now create a new child node or a next node for the current node based on child_is_first
+
+                if(!ChargeNode(ctx, ch))
+                    return false;
+
+                // List of child properties that need initialisation: [parent, name, previous_node]
+                if(child_is_first)
+                {
+                    current_node->child = new JSONNode;                 // Allocate memory for new child node
+                    current_node->child->parent = current_node;         // Set the childs parent
+                    current_node = current_node->child;                 // Set the current node to the child
+                }
+                else
+                {
+                    current_node->next = new JSONNode;                  // Allocate memory for new next node
+                    current_node->next->parent = current_node->parent;  // Set the next nodes parent
+                    current_node->next->previous = current_node;        // Set the next nodes previous node
+                    current_node = current_node->next;                  // Set the current node to the child
+                }
+
+                current_node->name = string_buffer;                     // Set current nodes name to the extracted string
+                current_node->name_hash = CPPJP::NameHash(string_buffer);
+                state = LEXSTATE::SEARCH_VALUE;
+                break;
+
+            case CharClass::INVALID:
+                printf("Unexpected character '%c'\n", *ch);
+                return Fail(ctx, JSONError::UNEXPECTED_CHARACTER, ch);
         }
 
-        ch++; // This should always run
+        ch++; // Past the single character token, or the closing quote of a string
     }
 
-    if(current_node != dest) // If we are not back at root parsing was unsuccessful
+    ctx.current_node = current_node;
+    ctx.state = state;
+    ctx.child_is_first = child_is_first;
+
+    return true;
+}
+
+bool CPPJP::ParsePartialRange(ParseContext& ctx, const char* ch, const char* end, size_t base_offset)
+{
+    ctx.begin = ch;
+    ctx.base_offset = base_offset;
+    return ParseRange(ctx, ch, end);
+}
+
+bool CPPJP::EndParse(ParseContext& ctx, const char* end)
+{
+    if(ctx.current_node != ctx.root || ctx.state != LEXSTATE::AWAIT_NEXT) // If we are not back at a complete root parsing was unsuccessful
     {
         puts("The final node was not root, invalid json file");
-        return false;
+        return Fail(ctx, JSONError::UNEXPECTED_END, end);
     }
 
     return true;
 }
 
-void CPPJP::WriteJson(JSONNode* node, std::string& output_buffer)
+bool CPPJP::ParseJSON(const char* json_str, JSONNode* dest)
+{
+    if(json_str == nullptr) return false;
+    return ParseJSON(json_str, strlen(json_str), dest, JSONParseOptions{});
+}
+
+bool CPPJP::ParseJSON(const char* json_str, size_t length, JSONNode* dest, const JSONParseOptions& options, JSONStatus* status)
+{
+    // Return early if the passed in pointer is null
+    if(dest == nullptr || json_str == nullptr)
+    {
+        if(status) *status = JSONStatus{ JSONError::UNEXPECTED_END, 0 };
+        return false;
+    }
+
+    JSONStatus result;
+    bool success;
+    {
+        CPPJP_STAT_TIMER(parse_ns);
+
+        if(options.threads != 1)
+            success = ParseJSONParallel(json_str, length, dest, options, result);
+        else
+            success = ParseDocument(json_str, length, dest, options, result);
+    }
+
+    if(status) *status = result;
+
+    CPPJP_STAT(
+        stats->bytes_parsed += length;
+        if(success) AccountTree(stats, dest);
+    );
+
+    return success;
+}
+
+bool CPPJP::ParseDocument(const char* json_str, size_t length, JSONNode* dest, const JSONParseOptions& options, JSONStatus& status)
+{
+    ParseContext ctx;
+    BeginParse(ctx, dest, json_str, options);
+
+    bool success = ParseRange(ctx, json_str, json_str + length) && EndParse(ctx, json_str + length);
+
+    status = ctx.status;
+    return success;
+}
+
+void CPPJP::WriteJson(JSONNode* node, std::string& output_buffer, std::string_view source)
 {
+    CPPJP_STAT_TIMER(write_ns);
+    [[maybe_unused]] size_t start_size = output_buffer.size();
+
     // Iterare through all nodes and create a json file
     // Basically parsing in reverse
 
@@ -401,25 +842,61 @@ void CPPJP::WriteJson(JSONNode* node, std::string& output_buffer)
 
     bool supress_name_printing = true;
 
+    // With a source, the absolute start of current_node is tracked so that unmodified
+    // subtrees can be copied from it. A node is positioned when it and every node its
+    // offset is relative to have a source span.
+    const bool reuse_source = !source.empty();
+    size_t position = 0;
+    bool positioned = reuse_source;
+    std::vector<std::pair<size_t, bool>> parent_positions;
+
+    if(reuse_source)
+    {
+        for(JSONNode* n = node; n; n = n->previous ? n->previous : n->parent)
+        {
+            position += SourceOffset(n);
+            positioned = positioned && SourceLength(n);
+        }
+    }
+
     while(current_node)
     {
         if(!supress_name_printing)
         {
-            if(!current_node->name.empty())
+            // Members of objects are named, the empty string included
+            if(current_node->parent && current_node->parent->type == JSONNodeType::OBJECT)
             {
-                output_buffer += "\"" + current_node->name + "\":";
+                // Names are held decoded and escaped again on the way out
+                output_buffer += '"';
+                CPPJP::EscapeString(current_node->name.data(), current_node->name.size(), output_buffer);
+                output_buffer += "\":";
             }
         }
         else
             supress_name_printing = false;
 
-        switch(current_node->type)
+        bool verbatim = positioned && (current_node->flags & NODE_SOURCE_CLEAN) &&
+            position <= source.size() && SourceLength(current_node) <= source.size() - position;
+
+        if(verbatim)
+            output_buffer.append(source.data() + position, SourceLength(current_node));
+        else switch(current_node->type)
         {
             case JSONNodeType::STRING:
-                output_buffer += "\"" + current_node->string_data + "\"";
+                // string_data is kept escaped, so it is copied out as is
+                output_buffer += '"';
+                output_buffer += current_node->string_data;
+                output_buffer += '"';
                 break;
             case JSONNodeType::NUMBER:
-                output_buffer += current_node->string_data;
+                if(IsUnformattedNumber(current_node))
+                {
+                    // Binary numbers are formatted straight into the output
+                    char buffer[max_number_text];
+                    output_buffer.append(buffer, FormatNumber(current_node, buffer));
+                }
+                else
+                    output_buffer += current_node->string_data;
                 break;
             case JSONNodeType::TRUE:
                 output_buffer += "true";
@@ -444,14 +921,32 @@ void CPPJP::WriteJson(JSONNode* node, std::string& output_buffer)
                 break;
         }
 
-        if(current_node->child)
+        if(current_node->child && !verbatim)
         {
             current_node = current_node->child;
+
+            if(reuse_source)
+            {
+                parent_positions.emplace_back(position, positioned);
+                position += SourceOffset(current_node);
+                positioned = positioned && SourceLength(current_node);
+            }
+        }
+        else if(current_node == node)
+        {
+            // A scalar or empty root, its siblings are not part of the output
+            break;
         }
         else if(current_node->next)
         {
             output_buffer += ",";
             current_node = current_node->next;
+
+            if(reuse_source)
+            {
+                position += SourceOffset(current_node);
+                positioned = positioned && SourceLength(current_node);
+            }
         }
         else
         {
@@ -459,6 +954,12 @@ void CPPJP::WriteJson(JSONNode* node, std::string& output_buffer)
             {
                 current_node = current_node->parent;
 
+                if(reuse_source)
+                {
+                    std::tie(position, positioned) = parent_positions.back();
+                    parent_positions.pop_back();
+                }
+
                 // Close the parent node
                 if(current_node->type == JSONNodeType::ARRAY)  output_buffer += "]";
                 if(current_node->type == JSONNodeType::OBJECT) output_buffer += "}";
@@ -471,6 +972,14 @@ void CPPJP::WriteJson(JSONNode* node, std::string& output_buffer)
 
             current_node = current_node->next;
             output_buffer += ",";
+
+            if(reuse_source)
+            {
+                position += SourceOffset(current_node);
+                positioned = positioned && SourceLength(current_node);
+            }
         }
     }
+
+    CPPJP_STAT(stats->bytes_written += output_buffer.size() - start_size);
 }
\ No newline at end of file
@@ -1,9 +1,104 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <functional>
 #include "cppjp.hpp"
 
 namespace CPPJP
 {
-    void WriteJson(JSONNode* node, std::string& output_buffer);
-}
\ No newline at end of file
+    enum class LEXSTATE
+    {
+        SEARCH_VALUE = 0,
+        SEARCH_NAME,
+        SEARCH_OBJECT_CHILD,
+        SEARCH_COLON,
+        AWAIT_NEXT
+    };
+
+    /*
+        State of the lexer between calls to ParseRange.
+    */
+    struct ParseContext
+    {
+        const char* begin;          // Start of the current input range
+        size_t base_offset;         // Offset of begin in the document, error offsets are relative to the document
+        bool partial_input;         // More input follows the current range
+        const char* resume;         // Set when a token runs into the end of a partial range, where parsing must resume
+        JSONParseOptions options;   // Limits of 0 are replaced with SIZE_MAX
+        JSONStatus status;
+        size_t depth;               // Arrays and objects open around the current node
+        size_t node_count;          // Nodes allocated so far
+        size_t total_bytes;         // Memory charged against options.max_total_bytes
+        JSONNode* root;
+        JSONNode* current_node;
+        LEXSTATE state;
+        std::string string_buffer;  // Name of the member being parsed, decoded
+        std::string escaped_name;   // Name as written, while it is decoded into string_buffer
+        bool child_is_first;
+    };
+
+    /*
+        Prepares ctx to parse a single JSON value into root.
+    */
+    void BeginParse(ParseContext& ctx, JSONNode* root, const char* begin, const JSONParseOptions& options);
+
+    /*
+        Prepares ctx to parse a comma separated run of array elements or object
+        members (without the surrounding brackets) as children of container.
+        On success the context is left in the AWAIT_NEXT state on the last child.
+    */
+    void BeginMembers(ParseContext& ctx, JSONNode* container, JSONNodeType type, const char* begin, const JSONParseOptions& options);
+
+    /*
+        Runs the lexer over [ch, end), continuing from the state stored in ctx.
+        @return ```true``` if no error was encountered, ```false``` otherwise with ctx.status set.
+    */
+    bool ParseRange(ParseContext& ctx, const char* ch, const char* end);
+
+    /*
+        Runs the lexer over [ch, end), which may end part way through a token when
+        ctx.partial_input is set. In that case ctx.resume is left pointing at the start of the
+        unfinished token and parsing must continue from there once more input has been
+        appended; otherwise it is ```nullptr```. Error offsets are base_offset + (at - ch).
+        @return ```true``` if no error was encountered, ```false``` otherwise with ctx.status set.
+    */
+    bool ParsePartialRange(ParseContext& ctx, const char* ch, const char* end, size_t base_offset);
+
+    /*
+        Checks that the parse in ctx finished a complete document.
+        @param end The end of the last range passed to the lexer.
+    */
+    bool EndParse(ParseContext& ctx, const char* end);
+
+    /*
+        Parses a document read from read on a background thread. read fills up to size bytes
+        and returns the number read, 0 at the end of the input or -1 on error.
+    */
+    bool ParseStream(const std::function<long(char*, size_t)>& read, JSONNode* dest, const JSONParseOptions& options, JSONStatus& status);
+
+    /*
+        Parses a complete document on the calling thread.
+    */
+    bool ParseDocument(const char* json_str, size_t length, JSONNode* dest, const JSONParseOptions& options, JSONStatus& status);
+
+    /*
+        Parses a document whose top level value is an array or object by
+        splitting its members across worker threads. Falls back to the
+        sequential parser whenever the input can not be split safely.
+    */
+    bool ParseJSONParallel(const char* json_str, size_t length, JSONNode* dest, const JSONParseOptions& options, JSONStatus& status);
+
+    /*
+        Finishes the source span of a container whose children carry absolute offsets: sets its
+        length and makes the offsets of its children relative.
+        @param end Absolute offset one past the closing bracket.
+    */
+    void CloseSourceSpan(JSONNode* container, size_t end);
+
+    /*
+        Appends the JSON text of node to output_buffer. When source is given, the text node was
+        parsed from with track_source, unmodified subtrees are copied from it.
+    */
+    void WriteJson(JSONNode* node, std::string& output_buffer, std::string_view source = {});
+}
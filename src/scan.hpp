@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/*
+    Byte scanning kernels shared by the validator and other text level passes.
+
+    The SSE2 paths are always available on x86-64. Other targets use the scalar loops, which
+    produce identical results.
+*/
+
+namespace CPPJP
+{
+    /*
+        JSON whitespace as defined by RFC 8259: space, tab, line feed and carriage return.
+    */
+    inline bool IsJSONSpace(char ch)
+    {
+        return ch == ' ' || ch == '\n' || ch == '\r' || ch == '\t';
+    }
+
+    inline bool IsDigit(char ch)
+    {
+        return static_cast<unsigned char>(ch - '0') < 10;
+    }
+
+    inline bool IsHexDigit(char ch)
+    {
+        return IsDigit(ch) || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+    }
+
+    inline const char* SkipJSONSpace(const char* ch, const char* end)
+    {
+        while(ch < end && IsJSONSpace(*ch)) ch++;
+        return ch;
+    }
+
+    /*
+        Finds the first byte in [ch, end) that ends a run of plain string characters:
+        a quote, a backslash or a control character below 0x20.
+        @return A pointer to that byte, or end if there is none.
+    */
+    inline const char* FindStringSpecial(const char* ch, const char* end)
+    {
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control_max = _mm_set1_epi8(0x1F);
+
+        while(end - ch >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ch));
+            __m128i special = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max), control_max)); // Unsigned chunk <= 0x1F
+
+            int mask = _mm_movemask_epi8(special);
+            if(mask) return ch + __builtin_ctz(mask);
+            ch += 16;
+        }
+#endif
+        while(ch < end)
+        {
+            unsigned char byte = static_cast<unsigned char>(*ch);
+            if(byte == '"' || byte == '\\' || byte < 0x20) return ch;
+            ch++;
+        }
+
+        return end;
+    }
+}
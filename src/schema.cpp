@@ -0,0 +1,445 @@
+#include <cmath>
+#include <cstring>
+#include <charconv>
+#include <algorithm>
+#include "cppjp_schema.hpp"
+#include "exceptions.hpp"
+#include "standalone.hpp"
+
+namespace
+{
+    // Type mask bits, one per JSONNodeType plus integers
+    const std::uint32_t integer_type = 1u << 7;
+
+    std::uint32_t TypeBit(JSONNodeType type)
+    {
+        return 1u << static_cast<std::uint32_t>(type);
+    }
+
+    std::uint32_t TypeMaskOf(const std::string& name)
+    {
+        if(name == "null")      return TypeBit(JSONNodeType::JNULL);
+        if(name == "boolean")   return TypeBit(JSONNodeType::TRUE) | TypeBit(JSONNodeType::FALSE);
+        if(name == "object")    return TypeBit(JSONNodeType::OBJECT);
+        if(name == "array")     return TypeBit(JSONNodeType::ARRAY);
+        if(name == "number")    return TypeBit(JSONNodeType::NUMBER);
+        if(name == "string")    return TypeBit(JSONNodeType::STRING);
+        if(name == "integer")   return integer_type;
+
+        throw json::invalid_schema("Unknown type \"" + name + "\"");
+    }
+
+    /*
+        Keywords that can not be ignored without accepting documents the schema rejects.
+    */
+    bool IsUnsupportedKeyword(const std::string& keyword)
+    {
+        static const char* unsupported[] = {
+            "$ref", "$dynamicRef", "allOf", "anyOf", "oneOf", "not", "if", "then", "else",
+            "pattern", "patternProperties", "propertyNames", "dependentRequired", "dependentSchemas",
+            "dependencies", "prefixItems", "additionalItems", "contains", "uniqueItems", "multipleOf",
+            "format", "unevaluatedItems", "unevaluatedProperties"
+        };
+
+        for(const char* name : unsupported)
+            if(keyword == name) return true;
+
+        return false;
+    }
+
+    double NumberValue(JSONNode* node)
+    {
+        if(node->flags & NODE_INT64) return static_cast<double>(node->number.int64);
+        if(node->flags & NODE_UINT64) return static_cast<double>(node->number.uint64);
+        if(node->flags & NODE_DOUBLE) return node->number.real;
+
+        double value = 0;
+        std::from_chars(node->string_data.data(), node->string_data.data() + node->string_data.size(), value);
+        return value;
+    }
+
+    bool IsInteger(JSONNode* node)
+    {
+        if(node->flags & (NODE_INT64 | NODE_UINT64)) return true;
+
+        double value = NumberValue(node);
+        return std::isfinite(value) && value == std::trunc(value);
+    }
+
+    double LimitOf(JSONNode* value, const std::string& keyword)
+    {
+        if(value->type != JSONNodeType::NUMBER)
+            throw json::invalid_schema("\"" + keyword + "\" must be a number");
+
+        return NumberValue(value);
+    }
+
+    std::uint32_t CountOf(JSONNode* value, const std::string& keyword)
+    {
+        if(value->type != JSONNodeType::NUMBER || !IsInteger(value) || NumberValue(value) < 0)
+            throw json::invalid_schema("\"" + keyword + "\" must be a non-negative integer");
+
+        return static_cast<std::uint32_t>(std::min(NumberValue(value), 4294967295.0));
+    }
+
+    /*
+        Counts the code points of a UTF-8 string.
+    */
+    size_t CodePoints(const std::string& text)
+    {
+        size_t count = 0;
+        for(char byte : text)
+            count += (static_cast<unsigned char>(byte) & 0xC0) != 0x80;
+        return count;
+    }
+
+    size_t ChildCount(const JSONNode* node)
+    {
+        size_t count = 0;
+        for(const JSONNode* child = node->child; child; child = child->next)
+            count++;
+        return count;
+    }
+
+    /*
+        Builds the JSON Pointer of node relative to root.
+    */
+    std::string PointerTo(const JSONNode* node, const JSONNode* root)
+    {
+        std::vector<std::string> segments;
+
+        for(; node != root; node = node->parent)
+        {
+            if(node->parent->type == JSONNodeType::ARRAY)
+            {
+                size_t index = 0;
+                for(const JSONNode* sibling = node->previous; sibling; sibling = sibling->previous)
+                    index++;
+                segments.push_back(std::to_string(index));
+                continue;
+            }
+
+            std::string segment;
+            for(char ch : node->name)
+            {
+                if(ch == '~') segment += "~0";
+                else if(ch == '/') segment += "~1";
+                else segment += ch;
+            }
+            segments.push_back(std::move(segment));
+        }
+
+        std::string path;
+        for(auto segment = segments.rbegin(); segment != segments.rend(); segment++)
+        {
+            path += '/';
+            path += *segment;
+        }
+        return path;
+    }
+}
+
+JSONSchema JSONSchema::Compile(JSON& schema)
+{
+    if(!schema.isValid()) throw json::bad_node_access();
+
+    JSONSchema compiled;
+    compiled.compile(schema.borrowNode());
+    return compiled;
+}
+
+/*
+    Compiles one schema and, recursively, its sub-schemas.
+    @return The index of the compiled program.
+*/
+std::uint32_t JSONSchema::compile(JSONNode* schema)
+{
+    std::uint32_t index = static_cast<std::uint32_t>(programs.size());
+    programs.emplace_back();
+
+    // Checks are gathered here so that sub-schemas compiled on the way do not split the run
+    std::vector<SchemaCheck> own;
+
+    if(schema->type == JSONNodeType::TRUE || schema->type == JSONNodeType::FALSE)
+    {
+        if(schema->type == JSONNodeType::FALSE)
+            own.push_back(SchemaCheck{ SchemaOp::REJECT, 0, 0, 0, "false" });
+    }
+    else if(schema->type != JSONNodeType::OBJECT)
+        throw json::invalid_schema("A schema must be an object or a boolean");
+
+    JSONNode* properties_node = nullptr;
+    JSONNode* required_node = nullptr;
+    JSONNode* additional_node = nullptr;
+
+    for(JSONNode* keyword = schema->type == JSONNodeType::OBJECT ? schema->child : nullptr; keyword; keyword = keyword->next)
+    {
+        const std::string& name = keyword->name;
+
+        if(IsUnsupportedKeyword(name))
+            throw json::invalid_schema("Unsupported keyword \"" + name + "\"");
+
+        if(name == "type")
+        {
+            std::uint32_t mask = 0;
+            if(keyword->type == JSONNodeType::STRING)
+                mask = TypeMaskOf(DecodedString(keyword));
+            else if(keyword->type == JSONNodeType::ARRAY)
+            {
+                for(JSONNode* type = keyword->child; type; type = type->next)
+                {
+                    if(type->type != JSONNodeType::STRING) throw json::invalid_schema("\"type\" must list type names");
+                    mask |= TypeMaskOf(DecodedString(type));
+                }
+            }
+            else
+                throw json::invalid_schema("\"type\" must be a string or an array");
+
+            // The type check always runs first
+            own.insert(own.begin(), SchemaCheck{ SchemaOp::TYPE, mask, 0, 0, "type" });
+        }
+        else if(name == "enum" || name == "const")
+        {
+            std::uint32_t first = static_cast<std::uint32_t>(constants.size());
+
+            if(name == "const")
+                constants.push_back(JSON::Adopt(CPPJP::CloneNode(keyword)));
+            else if(keyword->type != JSONNodeType::ARRAY)
+                throw json::invalid_schema("\"enum\" must be an array");
+            else
+                for(JSONNode* value = keyword->child; value; value = value->next)
+                    constants.push_back(JSON::Adopt(CPPJP::CloneNode(value)));
+
+            // Hash the constants now so only the validated values are hashed later
+            for(size_t i = first; i < constants.size(); i++)
+                constants[i].hash();
+
+            own.push_back(SchemaCheck{ SchemaOp::ENUM, first, static_cast<std::uint32_t>(constants.size() - first), 0, keyword->name == "enum" ? "enum" : "const" });
+        }
+        else if(name == "minimum")           own.push_back(SchemaCheck{ SchemaOp::MINIMUM, 0, 0, LimitOf(keyword, name), "minimum" });
+        else if(name == "maximum")           own.push_back(SchemaCheck{ SchemaOp::MAXIMUM, 0, 0, LimitOf(keyword, name), "maximum" });
+        else if(name == "exclusiveMinimum")  own.push_back(SchemaCheck{ SchemaOp::EXCLUSIVE_MINIMUM, 0, 0, LimitOf(keyword, name), "exclusiveMinimum" });
+        else if(name == "exclusiveMaximum")  own.push_back(SchemaCheck{ SchemaOp::EXCLUSIVE_MAXIMUM, 0, 0, LimitOf(keyword, name), "exclusiveMaximum" });
+        else if(name == "minLength")         own.push_back(SchemaCheck{ SchemaOp::MIN_LENGTH, CountOf(keyword, name), 0, 0, "minLength" });
+        else if(name == "maxLength")         own.push_back(SchemaCheck{ SchemaOp::MAX_LENGTH, CountOf(keyword, name), 0, 0, "maxLength" });
+        else if(name == "minItems")          own.push_back(SchemaCheck{ SchemaOp::MIN_ITEMS, CountOf(keyword, name), 0, 0, "minItems" });
+        else if(name == "maxItems")          own.push_back(SchemaCheck{ SchemaOp::MAX_ITEMS, CountOf(keyword, name), 0, 0, "maxItems" });
+        else if(name == "minProperties")     own.push_back(SchemaCheck{ SchemaOp::MIN_PROPERTIES, CountOf(keyword, name), 0, 0, "minProperties" });
+        else if(name == "maxProperties")     own.push_back(SchemaCheck{ SchemaOp::MAX_PROPERTIES, CountOf(keyword, name), 0, 0, "maxProperties" });
+        else if(name == "items")
+        {
+            if(keyword->type == JSONNodeType::ARRAY)
+                throw json::invalid_schema("Tuple form of \"items\" is not supported");
+
+            own.push_back(SchemaCheck{ SchemaOp::ITEMS, compile(keyword), 0, 0, "items" });
+        }
+        else if(name == "properties")
+        {
+            if(keyword->type != JSONNodeType::OBJECT) throw json::invalid_schema("\"properties\" must be an object");
+            properties_node = keyword;
+        }
+        else if(name == "required")
+        {
+            if(keyword->type != JSONNodeType::ARRAY) throw json::invalid_schema("\"required\" must be an array");
+            required_node = keyword;
+        }
+        else if(name == "additionalProperties")
+            additional_node = keyword;
+    }
+
+    if(properties_node || required_node || additional_node)
+    {
+        SchemaObject object;
+        object.first_property = static_cast<std::uint32_t>(this->properties.size());
+        object.additional = no_schema;
+
+        // Compile the sub-schemas first, their own property tables must not interleave with this one
+        std::vector<SchemaProperty> table;
+
+        if(properties_node)
+            for(JSONNode* property = properties_node->child; property; property = property->next)
+                table.push_back(SchemaProperty{ property->name, CPPJP::HashKey(property->name.data(), property->name.size()), compile(property), no_schema });
+
+        if(required_node)
+        {
+            for(JSONNode* name = required_node->child; name; name = name->next)
+            {
+                if(name->type != JSONNodeType::STRING) throw json::invalid_schema("\"required\" must list property names");
+
+                const std::string& required_name = DecodedString(name);
+                auto found = std::find_if(table.begin(), table.end(), [&](const SchemaProperty& property){ return property.name == required_name; });
+                if(found == table.end())
+                {
+                    table.push_back(SchemaProperty{ required_name, CPPJP::HashKey(required_name.data(), required_name.size()), no_schema, no_schema });
+                    found = table.end() - 1;
+                }
+
+                if(found->required == no_schema)
+                    found->required = object.required_count++;
+            }
+        }
+
+        if(additional_node)
+        {
+            if(additional_node->type == JSONNodeType::FALSE)
+                object.additional_allowed = false;
+            else if(additional_node->type != JSONNodeType::TRUE)
+                object.additional = compile(additional_node);
+        }
+
+        std::sort(table.begin(), table.end(), [](const SchemaProperty& a, const SchemaProperty& b){ return a.hash < b.hash; });
+
+        object.first_property = static_cast<std::uint32_t>(this->properties.size());
+        object.property_count = static_cast<std::uint32_t>(table.size());
+        this->properties.insert(this->properties.end(), table.begin(), table.end());
+
+        own.push_back(SchemaCheck{ SchemaOp::PROPERTIES, static_cast<std::uint32_t>(objects.size()), 0, 0, "properties" });
+        objects.push_back(object);
+    }
+
+    programs[index].first_check = static_cast<std::uint32_t>(checks.size());
+    programs[index].check_count = static_cast<std::uint32_t>(own.size());
+    checks.insert(checks.end(), own.begin(), own.end());
+
+    return index;
+}
+
+const JSONSchema::SchemaProperty* JSONSchema::findProperty(const SchemaObject& object, const JSONNode* member) const
+{
+    const SchemaProperty* first = properties.data() + object.first_property;
+    const SchemaProperty* last = first + object.property_count;
+
+    std::uint64_t hash = CPPJP::HashKey(member->name.data(), member->name.size());
+    const SchemaProperty* found = std::lower_bound(first, last, hash, [](const SchemaProperty& property, std::uint64_t value){ return property.hash < value; });
+
+    for(; found != last && found->hash == hash; found++)
+        if(found->name == member->name) return found;
+
+    return nullptr;
+}
+
+JSONSchemaResult JSONSchema::validate(JSON& document) const
+{
+    if(!document.isValid()) throw json::bad_node_access();
+
+    return validate(document.borrowNode());
+}
+
+JSONSchemaResult JSONSchema::validate(JSONNode* root) const
+{
+    JSONSchemaResult result;
+
+    // Values still to check, the next one in document order at the back
+    std::vector<std::pair<JSONNode*, std::uint32_t>> pending{ { root, 0 } };
+    std::vector<bool> required_seen;
+
+    auto fail = [&](const JSONNode* node, const char* keyword)
+    {
+        result.path = PointerTo(node, root);
+        result.keyword = keyword;
+        return result;
+    };
+
+    while(!pending.empty())
+    {
+        auto [node, program_index] = pending.back();
+        pending.pop_back();
+
+        const SchemaProgram& program = programs[program_index];
+        size_t children_begin = pending.size();
+
+        // Numbers are converted once however many numeric checks the schema has
+        double number = 0;
+        bool has_number = false;
+        auto value = [&]()
+        {
+            if(!has_number)
+            {
+                number = NumberValue(node);
+                has_number = true;
+            }
+            return number;
+        };
+
+        for(const SchemaCheck* check = checks.data() + program.first_check; check != checks.data() + program.first_check + program.check_count; check++)
+        {
+            bool passed = true;
+
+            switch(check->op)
+            {
+                case SchemaOp::TYPE:
+                    passed = (check->operand & TypeBit(node->type))
+                        || (node->type == JSONNodeType::NUMBER && (check->operand & integer_type) && IsInteger(node));
+                    break;
+
+                case SchemaOp::ENUM:
+                {
+                    passed = false;
+                    for(std::uint32_t i = 0; i < check->count && !passed; i++)
+                        passed = CPPJP::NodesEqual(node, const_cast<JSON&>(constants[check->operand + i]).borrowNode());
+                } break;
+
+                case SchemaOp::MINIMUM:             passed = node->type != JSONNodeType::NUMBER || value() >= check->limit; break;
+                case SchemaOp::MAXIMUM:             passed = node->type != JSONNodeType::NUMBER || value() <= check->limit; break;
+                case SchemaOp::EXCLUSIVE_MINIMUM:   passed = node->type != JSONNodeType::NUMBER || value() > check->limit; break;
+                case SchemaOp::EXCLUSIVE_MAXIMUM:   passed = node->type != JSONNodeType::NUMBER || value() < check->limit; break;
+
+                case SchemaOp::MIN_LENGTH:          passed = node->type != JSONNodeType::STRING || CodePoints(DecodedString(node)) >= check->operand; break;
+                case SchemaOp::MAX_LENGTH:          passed = node->type != JSONNodeType::STRING || CodePoints(DecodedString(node)) <= check->operand; break;
+
+                case SchemaOp::MIN_ITEMS:           passed = node->type != JSONNodeType::ARRAY || ChildCount(node) >= check->operand; break;
+                case SchemaOp::MAX_ITEMS:           passed = node->type != JSONNodeType::ARRAY || ChildCount(node) <= check->operand; break;
+                case SchemaOp::MIN_PROPERTIES:      passed = node->type != JSONNodeType::OBJECT || ChildCount(node) >= check->operand; break;
+                case SchemaOp::MAX_PROPERTIES:      passed = node->type != JSONNodeType::OBJECT || ChildCount(node) <= check->operand; break;
+
+                case SchemaOp::ITEMS:
+                    if(node->type == JSONNodeType::ARRAY)
+                        for(JSONNode* element = node->child; element; element = element->next)
+                            pending.emplace_back(element, check->operand);
+                    break;
+
+                case SchemaOp::PROPERTIES:
+                {
+                    if(node->type != JSONNodeType::OBJECT) break;
+
+                    const SchemaObject& object = objects[check->operand];
+                    required_seen.assign(object.required_count, false);
+                    size_t required_found = 0;
+
+                    for(JSONNode* member = node->child; member; member = member->next)
+                    {
+                        const SchemaProperty* property = findProperty(object, member);
+
+                        if(!property)
+                        {
+                            if(!object.additional_allowed) return fail(member, "additionalProperties");
+                            if(object.additional != no_schema) pending.emplace_back(member, object.additional);
+                            continue;
+                        }
+
+                        if(property->required != no_schema && !required_seen[property->required])
+                        {
+                            required_seen[property->required] = true;
+                            required_found++;
+                        }
+
+                        if(property->schema != no_schema) pending.emplace_back(member, property->schema);
+                    }
+
+                    if(required_found != object.required_count) return fail(node, "required");
+                } break;
+
+                case SchemaOp::REJECT:
+                    passed = false;
+                    break;
+            }
+
+            if(!passed) return fail(node, check->keyword);
+        }
+
+        // Children were queued in document order, the first must be checked first
+        std::reverse(pending.begin() + children_begin, pending.end());
+    }
+
+    return result;
+}
@@ -0,0 +1,137 @@
+#include <thread>
+#include "cppjp_snapshot.hpp"
+#include "exceptions.hpp"
+#include "standalone.hpp"
+
+namespace
+{
+    /*
+        Fills every lazily computed cache in the tree, so that reading it afterwards never
+        writes to a node.
+    */
+    void WarmCaches(JSONNode* root)
+    {
+        JSONNode* node = root;
+
+        while(node)
+        {
+            if(node->type == JSONNodeType::STRING) DecodedString(node);
+            else if(node->type == JSONNodeType::NUMBER) NumberText(node);
+
+            // Pre-order walk over child, next and parent links
+            if(node->child)
+            {
+                node = node->child;
+                continue;
+            }
+
+            while(node != root && !node->next)
+                node = node->parent;
+
+            node = node == root ? nullptr : node->next;
+        }
+
+        CPPJP::HashNode(root);
+    }
+}
+
+void JSONSnapshot::Slot::unpin()
+{
+    // Reaching zero means the slot was replaced and every pin taken on it is gone
+    if(balance.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        document = JSON::Adopt(nullptr);
+        in_use.store(false, std::memory_order_release);
+    }
+}
+
+JSONSnapshot::Pin::Pin(Slot* slot, JSONNode* root)
+    : slot(slot), view(JSON::Wrap(root))
+{}
+
+JSONSnapshot::Pin::Pin(Pin&& other) noexcept
+    : slot(other.slot), view(std::move(other.view))
+{
+    other.slot = nullptr;
+}
+
+JSONSnapshot::Pin& JSONSnapshot::Pin::operator=(Pin&& other) noexcept
+{
+    if(this == &other) return *this;
+
+    if(slot) slot->unpin();
+
+    slot = other.slot;
+    view = std::move(other.view);
+    other.slot = nullptr;
+
+    return *this;
+}
+
+JSONSnapshot::Pin::~Pin()
+{
+    if(slot) slot->unpin();
+}
+
+JSONSnapshot::JSONSnapshot()
+{
+    // Slot 0 is current, and empty, until the first publish
+    slots[0].in_use.store(true, std::memory_order_relaxed);
+}
+
+JSONSnapshot::~JSONSnapshot()
+{
+    slots[current.load(std::memory_order_acquire) >> index_shift].document = JSON::Adopt(nullptr);
+}
+
+void JSONSnapshot::publish(JSON&& document)
+{
+    if(!document.isValid() || !document.isOwning()) throw json::bad_node_access();
+
+    std::lock_guard<std::mutex> lock(publish_mutex);
+
+    WarmCaches(document.borrowNode());
+
+    size_t current_index = current.load(std::memory_order_relaxed) >> index_shift;
+
+    // Find a free slot, waiting only if readers still hold every old version
+    Slot* slot = nullptr;
+    size_t index = 0;
+    while(!slot)
+    {
+        for(index = 0; index < slot_count; index++)
+        {
+            if(index != current_index && !slots[index].in_use.load(std::memory_order_acquire))
+            {
+                slot = &slots[index];
+                break;
+            }
+        }
+
+        if(!slot) std::this_thread::yield();
+    }
+
+    slot->document = std::move(document);
+    slot->balance.store(0, std::memory_order_relaxed);
+    slot->in_use.store(true, std::memory_order_relaxed);
+
+    std::uint64_t previous = current.exchange(static_cast<std::uint64_t>(index) << index_shift, std::memory_order_acq_rel);
+
+    // Hand the pins taken on the previous version over to its slot
+    Slot& old_slot = slots[previous >> index_shift];
+    std::int64_t pins = static_cast<std::int64_t>(previous & count_mask);
+    if(old_slot.balance.fetch_add(pins, std::memory_order_acq_rel) == -pins)
+    {
+        old_slot.document = JSON::Adopt(nullptr);
+        old_slot.in_use.store(false, std::memory_order_release);
+    }
+}
+
+JSONSnapshot::Pin JSONSnapshot::pin() const
+{
+    std::uint64_t state = current.fetch_add(1, std::memory_order_acquire);
+    Slot* slot = &slots[state >> index_shift];
+
+    JSON& document = slot->document;
+    return Pin(slot, document.isValid() ? document.borrowNode() : nullptr);
+}
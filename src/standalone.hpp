@@ -1,3 +1,7 @@
+#pragma once
+
+#include <cstring>
+#include <charconv>
 #include "cppjp.hpp"
 
 static const char* node_type_names[] = { "String", "Number", "Object", "Array", "True", "False", "Null" };
@@ -10,4 +14,169 @@ inline const char* getNodeTypeCString(JSONNode* node)
 inline const char* NodeTypeAsCString(JSONNodeType type)
 {
     return node_type_names[static_cast<std::uint8_t>(type)];
-}
\ No newline at end of file
+}
+
+/*
+    Checks whether a string stores its characters outside of the small string buffer.
+*/
+inline bool IsHeapAllocated(const std::string& str)
+{
+    return str.capacity() > std::string().capacity();
+}
+
+/*
+    Finds the member of an object with the given name. Names are compared by length, then by
+    name hash where both the key's and the member's are known, before any of their bytes are.
+    @param name_hash CPPJP::NameHash() of the key, 0 if not known.
+    @return The member, or ```nullptr``` if there is none.
+*/
+inline JSONNode* FindEntry(JSONNode* object, const char* key, size_t length, std::uint16_t name_hash = 0)
+{
+    for(JSONNode* current_node = object->child; current_node; current_node = current_node->next)
+    {
+        const std::string& name = current_node->name;
+        if(name.size() != length) continue;
+        if(name_hash && current_node->name_hash && current_node->name_hash != name_hash) continue;
+        if(memcmp(name.data(), key, length) == 0) return current_node;
+    }
+
+    return nullptr;
+}
+
+/*
+    Returns the out of line data of a node, allocating it on first use.
+*/
+inline JSONNodeExtra& NodeExtra(JSONNode* node)
+{
+    if(!node->extra) node->extra.reset(new JSONNodeExtra);
+    return *node->extra;
+}
+
+/*
+    The source span of a node, zero for nodes without one.
+*/
+inline size_t SourceOffset(const JSONNode* node) { return node->extra ? node->extra->source_offset : 0; }
+inline size_t SourceLength(const JSONNode* node) { return node->extra ? node->extra->source_length : 0; }
+
+/*
+    Takes a node out of the chain of relative source offsets before it leaves its sibling list
+    or moves to another tree. The offset of the next sibling, which was relative to this node,
+    is rebased onto whatever came before it. The node and its subtree lose their source span
+    and are written out token by token from then on.
+*/
+inline void DropSourceSpan(JSONNode* node)
+{
+    node->flags &= ~NODE_SOURCE_CLEAN;
+    if(!node->extra) return;
+
+    if(node->next && node->extra->source_offset) NodeExtra(node->next).source_offset += node->extra->source_offset;
+
+    node->extra->source_offset = 0;
+    node->extra->source_length = 0;
+}
+
+/*
+    Discards the source checkpoints of a container before its list of children changes.
+*/
+inline void DropCheckpoints(JSONNode* container)
+{
+    if(!container->extra || !container->extra->checkpoints) return;
+
+    for(const JSONSourceCheckpoint& checkpoint : *container->extra->checkpoints)
+        checkpoint.node->flags &= ~NODE_CHECKPOINT;
+
+    container->extra->checkpoints.reset();
+}
+
+/*
+    Visits root and all of its descendants in depth first order without recursion.
+    visit is called as visit(node, depth) where root has a depth of 0.
+*/
+template<typename F>
+inline void WalkSubtree(JSONNode* root, F&& visit)
+{
+    JSONNode* current_node = root;
+    size_t depth = 0;
+
+    while(current_node)
+    {
+        visit(current_node, depth);
+
+        if(current_node->child)
+        {
+            current_node = current_node->child;
+            depth++;
+            continue;
+        }
+
+        // Walk back up until a sibling is available
+        while(current_node != root && !current_node->next)
+        {
+            current_node = current_node->parent;
+            depth--;
+        }
+
+        if(current_node == root) break;
+
+        current_node = current_node->next;
+    }
+}
+
+/*
+    Returns the decoded contents of a string node. Strings without escapes are returned as they
+    are; escaped strings are decoded into the node's out of line data on first use.
+*/
+inline const std::string& DecodedString(JSONNode* node)
+{
+    if(!(node->flags & NODE_HAS_ESCAPES)) return node->string_data;
+
+    std::string& decoded = NodeExtra(node).decoded_data;
+    if(!(node->flags & NODE_DECODED))
+    {
+        decoded.clear();
+        CPPJP::DecodeString(node->string_data.data(), node->string_data.size(), decoded);
+        node->flags |= NODE_DECODED;
+    }
+
+    return decoded;
+}
+
+// Longest text FormatNumber produces
+const size_t max_number_text = 32;
+
+/*
+    Checks whether a node holds a binary number whose text has not been formatted yet.
+*/
+inline bool IsUnformattedNumber(const JSONNode* node)
+{
+    return (node->flags & (NODE_INT64 | NODE_UINT64 | NODE_DOUBLE)) && !(node->flags & NODE_FORMATTED);
+}
+
+/*
+    Writes the text of a binary number to buffer, which must hold max_number_text bytes.
+    Doubles are written as the shortest text that reads back as the same value.
+    @return The end of the text.
+*/
+inline char* FormatNumber(const JSONNode* node, char* buffer)
+{
+    char* end = buffer + max_number_text;
+
+    if(node->flags & NODE_INT64) return std::to_chars(buffer, end, node->number.int64).ptr;
+    if(node->flags & NODE_UINT64) return std::to_chars(buffer, end, node->number.uint64).ptr;
+    return std::to_chars(buffer, end, node->number.real).ptr;
+}
+
+/*
+    Returns the text of a number node, formatting binary numbers into string_data on first use.
+*/
+inline const std::string& NumberText(JSONNode* node)
+{
+    if(IsUnformattedNumber(node))
+    {
+        char buffer[max_number_text];
+        node->string_data.assign(buffer, FormatNumber(node, buffer));
+        node->flags |= NODE_FORMATTED;
+    }
+
+    return node->string_data;
+}
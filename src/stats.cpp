@@ -0,0 +1,74 @@
+#include "cppjp.hpp"
+#include "stats.hpp"
+#include "standalone.hpp"
+
+#ifdef CPPJP_STATS
+
+static thread_local JSONStats* current_stats = nullptr;
+
+JSONStats* CPPJP::CurrentStats() { return current_stats; }
+
+void CPPJP::AccountTree(JSONStats* stats, JSONNode* root)
+{
+    WalkSubtree(root, [stats](JSONNode* node, size_t depth)
+    {
+        stats->nodes_by_type[static_cast<std::uint8_t>(node->type)]++;
+        if(depth > stats->max_depth) stats->max_depth = depth;
+
+        stats->allocations++;
+        stats->allocated_bytes += sizeof(JSONNode);
+
+        for(const std::string* str : { &node->name, &node->string_data })
+        {
+            if(IsHeapAllocated(*str))
+            {
+                stats->allocations++;
+                stats->allocated_bytes += str->capacity() + 1;
+            }
+        }
+
+        if(node->extra)
+        {
+            stats->allocations++;
+            stats->allocated_bytes += sizeof(JSONNodeExtra);
+        }
+    });
+}
+
+void CPPJP::SetStats(JSONStats* stats) { current_stats = stats; }
+
+#else
+
+void CPPJP::SetStats(JSONStats*) {}
+
+#endif
+
+bool CPPJP::StatsEnabled()
+{
+#ifdef CPPJP_STATS
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t CPPJP::MemoryUsage(JSONNode* root)
+{
+    if(!root) return 0;
+
+    size_t bytes = 0;
+    WalkSubtree(root, [&bytes](JSONNode* node, size_t)
+    {
+        bytes += sizeof(JSONNode);
+        if(IsHeapAllocated(node->name)) bytes += node->name.capacity() + 1;
+        if(IsHeapAllocated(node->string_data)) bytes += node->string_data.capacity() + 1;
+        if(node->extra)
+        {
+            bytes += sizeof(JSONNodeExtra);
+            if(IsHeapAllocated(node->extra->decoded_data)) bytes += node->extra->decoded_data.capacity() + 1;
+            if(node->extra->checkpoints) bytes += sizeof(std::vector<JSONSourceCheckpoint>) + node->extra->checkpoints->capacity() * sizeof(JSONSourceCheckpoint);
+        }
+    });
+
+    return bytes;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "cppjp.hpp"
+
+/*
+    Internal statistics hooks.
+
+    Every hook compiles to nothing unless the library is built with CPPJP_STATS defined,
+    and otherwise only does work while a JSONStats sink is attached to the calling thread.
+*/
+
+#ifdef CPPJP_STATS
+
+#include <chrono>
+
+namespace CPPJP
+{
+    JSONStats* CurrentStats();
+
+    /*
+        Adds the time between construction and destruction to a JSONStats field.
+    */
+    class StatTimer
+    {
+        public:
+            explicit StatTimer(std::uint64_t JSONStats::* field)
+                : stats(CurrentStats()), field(field)
+            {
+                if(stats) start = std::chrono::steady_clock::now();
+            }
+
+            ~StatTimer()
+            {
+                if(stats) stats->*field += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+
+        private:
+            JSONStats* stats;
+            std::uint64_t JSONStats::* field;
+            std::chrono::steady_clock::time_point start;
+    };
+
+    /*
+        Adds the node counts, depth and allocations of a freshly built tree to stats.
+    */
+    void AccountTree(JSONStats* stats, JSONNode* root);
+}
+
+#define CPPJP_STAT(statement) do { if(JSONStats* stats = CPPJP::CurrentStats()) { statement; } } while(0)
+#define CPPJP_STAT_TIMER(field) CPPJP::StatTimer cppjp_stat_timer(&JSONStats::field)
+
+#else
+
+#define CPPJP_STAT(statement) do {} while(0)
+#define CPPJP_STAT_TIMER(field) do {} while(0)
+
+#endif
@@ -0,0 +1,265 @@
+#include <mutex>
+#include <atomic>
+#include <cerrno>
+#include <thread>
+#include <vector>
+#include <istream>
+#include <unistd.h>
+#include <condition_variable>
+#include "parser.hpp"
+#include "cppjp.hpp"
+#include "stats.hpp"
+
+/*
+    Parsing from file descriptors and streams.
+
+    A background thread reads the input into two buffers in turn while the parser works through
+    the other one, so reading and parsing overlap. The lexer is run over every buffer as it
+    arrives; a token cut off by the end of a buffer is carried over and parsed again together
+    with the start of the next buffer.
+*/
+
+namespace
+{
+    const size_t stream_buffer_size = 256 * 1024;
+
+    /*
+        Double buffered read ahead on a background thread.
+    */
+    class ReadAhead
+    {
+        public:
+            explicit ReadAhead(const std::function<long(char*, size_t)>& read)
+                : read(read)
+            {
+                for(Slot& slot : slots)
+                    slot.data.resize(stream_buffer_size);
+
+                reader = std::thread([this](){ readLoop(); });
+            }
+
+            ~ReadAhead()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    stopping = true;
+                }
+                changed.notify_all();
+                reader.join();
+            }
+
+            /*
+                Waits for the next filled buffer. It remains valid until release is called.
+                @return ```false``` once the input is exhausted, with failed set on a read error.
+            */
+            bool next(const char*& data, size_t& size)
+            {
+                Slot& slot = slots[consumed % 2];
+
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&](){ return slot.full || finished_at == consumed; });
+                if(!slot.full) return false;
+
+                data = slot.data.data();
+                size = slot.size;
+                return true;
+            }
+
+            void release()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slots[consumed % 2].full = false;
+                    consumed++;
+                }
+                changed.notify_all();
+            }
+
+            bool failed() const { return read_failed; }
+
+        private:
+            struct Slot
+            {
+                std::vector<char> data;
+                size_t size = 0;
+                bool full = false;
+            };
+
+            std::function<long(char*, size_t)> read;
+            std::thread reader;
+            Slot slots[2];
+
+            std::mutex mutex;
+            std::condition_variable changed;
+            size_t consumed = 0;                    // Buffers handed back by the parser
+            size_t finished_at = SIZE_MAX;          // Number of buffers filled once the input ended
+            std::atomic<bool> stopping{ false };
+            bool read_failed = false;
+
+            void readLoop()
+            {
+                size_t produced = 0;
+
+                while(true)
+                {
+                    Slot& slot = slots[produced % 2];
+
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [&](){ return stopping || !slot.full; });
+                        if(stopping) return;
+                    }
+
+                    // Fill the whole buffer so pipes delivering small writes still give large ranges
+                    size_t size = 0;
+                    bool at_end = false;
+                    while(size < slot.data.size() && !stopping)
+                    {
+                        long count = read(slot.data.data() + size, slot.data.size() - size);
+                        if(count <= 0)
+                        {
+                            read_failed = count < 0;
+                            at_end = true;
+                            break;
+                        }
+                        size += count;
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        if(size)
+                        {
+                            slot.size = size;
+                            slot.full = true;
+                            produced++;
+                        }
+                        if(at_end) finished_at = produced;
+                    }
+                    changed.notify_all();
+
+                    if(at_end) return;
+                }
+            }
+    };
+}
+
+bool CPPJP::ParseStream(const std::function<long(char*, size_t)>& read, JSONNode* dest, const JSONParseOptions& options, JSONStatus& status)
+{
+    CPPJP_STAT_TIMER(parse_ns);
+
+    ParseContext ctx;
+    BeginParse(ctx, dest, nullptr, options);
+    ctx.partial_input = true;
+
+    ReadAhead input(read);
+
+    std::string carry;          // Unfinished token from the previous buffer and the input after it
+    size_t carry_offset = 0;    // Document offset of the start of carry, or of the next buffer if carry is empty
+    size_t retry_size = 0;      // Carry is not parsed again until it reaches this size
+
+    const char* data;
+    size_t size;
+    bool success = true;
+
+    while(success && input.next(data, size))
+    {
+        if(carry.empty())
+        {
+            // Parse straight out of the read buffer
+            success = ParsePartialRange(ctx, data, data + size, carry_offset);
+            if(success && ctx.resume)
+            {
+                carry.assign(ctx.resume, data + size);
+                carry_offset += ctx.resume - data;
+            }
+            else
+                carry_offset += size;
+
+            input.release();
+            continue;
+        }
+
+        carry.append(data, size);
+        input.release();
+
+        // A token longer than a buffer is only retried once the carry has doubled, so very long
+        // strings are not rescanned for every buffer
+        if(carry.size() < retry_size) continue;
+
+        success = ParsePartialRange(ctx, carry.data(), carry.data() + carry.size(), carry_offset);
+        if(success && ctx.resume)
+        {
+            size_t consumed = ctx.resume - carry.data();
+            retry_size = consumed ? 0 : carry.size() * 2;
+            carry.erase(0, consumed);
+            carry_offset += consumed;
+        }
+        else
+        {
+            carry_offset += carry.size();
+            carry.clear();
+            retry_size = 0;
+        }
+    }
+
+    if(success && input.failed())
+    {
+        ctx.status = JSONStatus{ JSONError::READ_FAILED, carry_offset + carry.size() };
+        success = false;
+    }
+
+    if(success)
+    {
+        // Whatever is left must form complete tokens now that no more input follows
+        ctx.partial_input = false;
+        success = ParsePartialRange(ctx, carry.data(), carry.data() + carry.size(), carry_offset)
+            && EndParse(ctx, carry.data() + carry.size());
+    }
+
+    status = ctx.status;
+
+    CPPJP_STAT(
+        stats->bytes_parsed += carry_offset + carry.size();
+        if(success) AccountTree(stats, dest);
+    );
+
+    return success;
+}
+
+namespace
+{
+    JSON StreamToJSON(const std::function<long(char*, size_t)>& read, const JSONParseOptions& options, JSONStatus* status)
+    {
+        JSONNode* root = new JSONNode;
+        JSONStatus result;
+        bool success = CPPJP::ParseStream(read, root, options, result);
+
+        if(status) *status = result;
+        if(success) return JSON::Adopt(root);
+
+        CPPJP::FreeNode(root);
+        return JSON::Adopt(nullptr);
+    }
+}
+
+JSON JSON::FromStream(int fd, const JSONParseOptions& options, JSONStatus* status)
+{
+    return StreamToJSON([fd](char* buffer, size_t size) -> long
+    {
+        while(true)
+        {
+            ssize_t count = ::read(fd, buffer, size);
+            if(count >= 0 || errno != EINTR) return count;
+        }
+    }, options, status);
+}
+
+JSON JSON::FromStream(std::istream& stream, const JSONParseOptions& options, JSONStatus* status)
+{
+    return StreamToJSON([&stream](char* buffer, size_t size) -> long
+    {
+        stream.read(buffer, size);
+        if(stream.bad()) return -1;
+        return stream.gcount();
+    }, options, status);
+}
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include "thread_pool.hpp"
+#include "cppjp.hpp"
+
+namespace
+{
+    // Set while the thread is running a task, nested batches then run inline
+    thread_local bool in_pool_task = false;
+}
+
+CPPJP::ThreadPool::ThreadPool(unsigned worker_count)
+{
+    for(unsigned i = 0; i <= worker_count; i++)
+        queues.push_back(std::make_unique<Queue>());
+
+    for(unsigned i = 1; i <= worker_count; i++)
+        workers.emplace_back([this, i](){ workerLoop(i); });
+}
+
+CPPJP::ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for(std::thread& worker : workers)
+        worker.join();
+}
+
+void CPPJP::ThreadPool::workerLoop(unsigned index)
+{
+    size_t seen_generation = 0;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&](){ return stopping || generation != seen_generation; });
+            if(stopping) return;
+
+            seen_generation = generation;
+            if(index >= participant_count) continue;
+        }
+
+        while(runOne(index)) {}
+    }
+}
+
+/*
+    Takes a task from the back of the participant's own queue, or steals one from the front of
+    another queue, and runs it.
+    @return ```false``` if no task was left to take.
+*/
+bool CPPJP::ThreadPool::runOne(unsigned index)
+{
+    size_t task_index = 0;
+    bool found = false;
+
+    for(size_t offset = 0; offset < queues.size() && !found; offset++)
+    {
+        Queue& queue = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if(queue.tasks.empty()) continue;
+
+        if(offset == 0)
+        {
+            task_index = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task_index = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        found = true;
+    }
+
+    if(!found) return false;
+
+    in_pool_task = true;
+    try
+    {
+        (*current_task)(task_index);
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!error) error = std::current_exception();
+    }
+    in_pool_task = false;
+
+    if(remaining.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.notify_all();
+    }
+
+    return true;
+}
+
+void CPPJP::ThreadPool::run(size_t task_count, unsigned participants, const std::function<void(size_t)>& task)
+{
+    if(participants == 0 || participants > size()) participants = size();
+
+    if(in_pool_task || participants == 1 || task_count <= 1)
+    {
+        for(size_t i = 0; i < task_count; i++)
+            task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> batch_lock(batch_mutex);
+
+    current_task = &task;
+    remaining = task_count;
+    error = nullptr;
+
+    // Deal the tasks out so every participant starts with an even share
+    for(size_t i = 0; i < task_count; i++)
+    {
+        Queue& queue = *queues[i % participants];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(i);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        participant_count = participants;
+        generation++;
+    }
+    wake.notify_all();
+
+    while(runOne(0)) {}
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&](){ return remaining == 0; });
+
+    if(error)
+    {
+        std::exception_ptr thrown = error;
+        error = nullptr;
+        std::rethrow_exception(thrown);
+    }
+}
+
+CPPJP::ThreadPool& CPPJP::SharedPool()
+{
+    static ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+    return pool;
+}
+
+void CPPJP::RunParallel(size_t task_count, unsigned threads, const std::function<void(size_t)>& task)
+{
+    SharedPool().run(task_count, threads, task);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+namespace CPPJP
+{
+    /*
+        A fixed set of worker threads that run batches of indexed tasks.
+
+        Every participant, including the calling thread, owns a queue of task indices. The
+        tasks of a batch are dealt out across the queues; participants take work from the back
+        of their own queue and, once it is empty, steal from the front of the others, so uneven
+        tasks even out without a central queue.
+    */
+    class ThreadPool
+    {
+        public:
+            explicit ThreadPool(unsigned worker_count);
+            ~ThreadPool();
+
+            ThreadPool(const ThreadPool&) = delete;
+            ThreadPool& operator=(const ThreadPool&) = delete;
+
+            /*
+                Runs task(i) for every i in [0, task_count) on up to participants threads, the
+                calling thread included, and returns once all of them have finished. The first
+                exception thrown by a task is rethrown here. Calls made from inside a task run
+                sequentially on the calling thread.
+            */
+            void run(size_t task_count, unsigned participants, const std::function<void(size_t)>& task);
+
+            /*
+                @return The number of threads that can take part in a batch, the caller included.
+            */
+            unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+        private:
+            struct Queue
+            {
+                std::mutex mutex;
+                std::deque<size_t> tasks;
+            };
+
+            std::vector<std::thread> workers;
+            std::vector<std::unique_ptr<Queue>> queues;     // queues[0] belongs to the calling thread
+
+            std::mutex batch_mutex;                         // Serialises calls to run
+            std::mutex mutex;
+            std::condition_variable wake;
+            std::condition_variable done;
+
+            const std::function<void(size_t)>* current_task = nullptr;
+            std::atomic<size_t> remaining{0};
+            unsigned participant_count = 0;
+            size_t generation = 0;
+            bool stopping = false;
+            std::exception_ptr error;
+
+            void workerLoop(unsigned index);
+            bool runOne(unsigned index);
+    };
+
+    /*
+        @return The pool shared by every parallel operation in the library, sized to the machine.
+    */
+    ThreadPool& SharedPool();
+}
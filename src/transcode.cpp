@@ -0,0 +1,127 @@
+#include <string>
+#include <cstring>
+#include "validator.hpp"
+
+/*
+    Text to text reformatting.
+
+    Both passes run the validator over the input and write each token as it is accepted, so
+    no tree is built and invalid input is rejected in the same single scan. Strings, numbers
+    and keywords are copied in one piece each, whitespace between tokens is dropped and
+    regenerated.
+*/
+
+namespace
+{
+    /*
+        Writes through a raw cursor into space reserved up front, which is safe because
+        minified text is never longer than its input.
+    */
+    class MinifyOutput : public CPPJP::NullOutput
+    {
+        public:
+            explicit MinifyOutput(char* cursor) : cursor(cursor) {}
+
+            char* cursor;
+
+            void value(const char* begin, const char* end)
+            {
+                memcpy(cursor, begin, end - begin);
+                cursor += end - begin;
+            }
+
+            void name(const char* begin, const char* end)
+            {
+                value(begin, end);
+                *cursor++ = ':';
+            }
+
+            void open(char bracket, size_t) { *cursor++ = bracket; }
+            void close(char bracket, size_t) { *cursor++ = bracket; }
+
+            void empty(char open, char close)
+            {
+                *cursor++ = open;
+                *cursor++ = close;
+            }
+
+            void comma(size_t) { *cursor++ = ','; }
+    };
+
+    class ReformatOutput : public CPPJP::NullOutput
+    {
+        public:
+            ReformatOutput(std::string& out, unsigned indent) : out(out), indent(indent) {}
+
+            void value(const char* begin, const char* end) { out.append(begin, end - begin); }
+
+            void name(const char* begin, const char* end)
+            {
+                out.append(begin, end - begin);
+                out += ": ";
+            }
+
+            void open(char bracket, size_t depth)
+            {
+                out += bracket;
+                newLine(depth);
+            }
+
+            void close(char bracket, size_t depth)
+            {
+                newLine(depth);
+                out += bracket;
+            }
+
+            void empty(char open, char close)
+            {
+                out += open;
+                out += close;
+            }
+
+            void comma(size_t depth)
+            {
+                out += ',';
+                newLine(depth);
+            }
+
+        private:
+            std::string& out;
+            unsigned indent;
+
+            void newLine(size_t depth)
+            {
+                out += '\n';
+                out.append(depth * indent, ' ');
+            }
+    };
+}
+
+JSONStatus JSON::Minify(const char* str, size_t length, std::string& out)
+{
+    if(!str) return JSONStatus{ JSONError::UNEXPECTED_END, 0 };
+
+    size_t original_size = out.size();
+    out.resize(original_size + length);
+
+    MinifyOutput output(out.data() + original_size);
+    CPPJP::Validator<MinifyOutput> validator(str, str + length, output);
+    JSONStatus status = validator.run();
+
+    out.resize(status ? output.cursor - out.data() : original_size);
+    return status;
+}
+
+JSONStatus JSON::Reformat(const char* str, size_t length, std::string& out, unsigned indent)
+{
+    if(!str) return JSONStatus{ JSONError::UNEXPECTED_END, 0 };
+
+    size_t original_size = out.size();
+
+    ReformatOutput output(out, indent);
+    CPPJP::Validator<ReformatOutput> validator(str, str + length, output);
+    JSONStatus status = validator.run();
+
+    if(!status) out.resize(original_size);
+    return status;
+}
@@ -0,0 +1,163 @@
+#include <cstdint>
+#include <cstring>
+#include "utf8.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPPJP_UTF8_X86
+#endif
+
+/*
+    UTF-8 validation.
+
+    JSON text is overwhelmingly ASCII, so every implementation skips whole blocks of ASCII
+    with a single test and only decodes multi-byte sequences one at a time. The block test
+    is 8 bytes wide in the scalar version, 16 bytes with SSE2 and 32 bytes with AVX2; the
+    widest one the CPU supports is chosen at start up. Ranges too short for a vector block
+    go straight to the scalar version.
+*/
+
+namespace
+{
+    /*
+        Checks a single multi-byte sequence starting at ch, following Table 3-7 of the
+        Unicode standard.
+        @return The length of the sequence, or 0 if it is ill-formed.
+    */
+    inline size_t SequenceLength(const unsigned char* ch, const unsigned char* end)
+    {
+        unsigned char lead = ch[0];
+        size_t available = end - ch;
+
+        // Allowed range for the second byte, the remaining bytes are always 80..BF
+        unsigned char low = 0x80, high = 0xBF;
+        size_t length;
+
+        if(lead >= 0xC2 && lead <= 0xDF) length = 2;
+        else if(lead == 0xE0) { length = 3; low = 0xA0; }           // Overlong
+        else if(lead == 0xED) { length = 3; high = 0x9F; }          // Surrogates
+        else if(lead >= 0xE1 && lead <= 0xEF) length = 3;
+        else if(lead == 0xF0) { length = 4; low = 0x90; }           // Overlong
+        else if(lead == 0xF4) { length = 4; high = 0x8F; }          // Above U+10FFFF
+        else if(lead >= 0xF1 && lead <= 0xF3) length = 4;
+        else return 0;                                              // Continuation byte, C0, C1 or F5..FF
+
+        if(available < length) return 0;
+        if(ch[1] < low || ch[1] > high) return 0;
+
+        for(size_t i = 2; i < length; i++)
+            if((ch[i] & 0xC0) != 0x80) return 0;
+
+        return length;
+    }
+
+    /*
+        Validates the multi-byte sequences from ch up to the next ASCII byte.
+        @return ```true``` with ch moved to the next ASCII byte (or end), or ```false``` with
+        ch left at the invalid sequence.
+    */
+    inline bool SkipNonASCII(const unsigned char*& ch, const unsigned char* end)
+    {
+        while(ch < end && *ch >= 0x80)
+        {
+            size_t length = SequenceLength(ch, end);
+            if(!length) return false;
+            ch += length;
+        }
+        return true;
+    }
+
+    inline const char* FindInvalidScalar(const char* begin, const char* end)
+    {
+        const unsigned char* ch = reinterpret_cast<const unsigned char*>(begin);
+        const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+
+        while(ch < last)
+        {
+            if(last - ch >= 8)
+            {
+                std::uint64_t block;
+                memcpy(&block, ch, sizeof(block));
+                if(!(block & 0x8080808080808080ULL))
+                {
+                    ch += 8;
+                    continue;
+                }
+            }
+
+            if(*ch < 0x80) { ch++; continue; }
+            if(!SkipNonASCII(ch, last)) return reinterpret_cast<const char*>(ch);
+        }
+
+        return end;
+    }
+
+#ifdef CPPJP_UTF8_X86
+
+    __attribute__((target("sse2")))
+    const char* FindInvalidSSE2(const char* begin, const char* end)
+    {
+        const unsigned char* ch = reinterpret_cast<const unsigned char*>(begin);
+        const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+
+        while(last - ch >= 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ch)));
+            if(!mask)
+            {
+                ch += 16;
+                continue;
+            }
+
+            ch += __builtin_ctz(mask);
+            if(!SkipNonASCII(ch, last)) return reinterpret_cast<const char*>(ch);
+        }
+
+        return FindInvalidScalar(reinterpret_cast<const char*>(ch), end);
+    }
+
+    __attribute__((target("avx2")))
+    const char* FindInvalidAVX2(const char* begin, const char* end)
+    {
+        const unsigned char* ch = reinterpret_cast<const unsigned char*>(begin);
+        const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+
+        while(last - ch >= 32)
+        {
+            unsigned mask = _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ch)));
+            if(!mask)
+            {
+                ch += 32;
+                continue;
+            }
+
+            ch += __builtin_ctz(mask);
+            if(!SkipNonASCII(ch, last)) return reinterpret_cast<const char*>(ch);
+        }
+
+        return FindInvalidScalar(reinterpret_cast<const char*>(ch), end);
+    }
+
+#endif
+
+    using FindInvalidFunction = const char* (*)(const char*, const char*);
+
+    FindInvalidFunction SelectImplementation()
+    {
+#ifdef CPPJP_UTF8_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) return FindInvalidAVX2;
+        if(__builtin_cpu_supports("sse2")) return FindInvalidSSE2;
+#endif
+        return FindInvalidScalar;
+    }
+}
+
+static const FindInvalidFunction implementation = SelectImplementation();
+
+const char* CPPJP::FindInvalidUTF8(const char* begin, const char* end)
+{
+    // Most strings are short, skip the dispatch when no vector block fits
+    if(end - begin < 32) return FindInvalidScalar(begin, end);
+    return implementation(begin, end);
+}
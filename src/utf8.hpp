@@ -0,0 +1,13 @@
+#pragma once
+
+namespace CPPJP
+{
+    /*
+        Finds the first byte of the first ill-formed UTF-8 sequence in [begin, end).
+        Overlong encodings, UTF-16 surrogates, code points above U+10FFFF and sequences
+        truncated by end are all ill-formed.
+        The implementation is selected once at run time based on the CPU.
+        @return A pointer to the start of the invalid sequence, or end if the range is valid.
+    */
+    const char* FindInvalidUTF8(const char* begin, const char* end);
+}
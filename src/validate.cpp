@@ -0,0 +1,41 @@
+#include "validator.hpp"
+
+JSONStatus CPPJP::Validate(const char* json_str, size_t length, bool check_utf8)
+{
+    if(!json_str) return JSONStatus{ JSONError::UNEXPECTED_END, 0 };
+
+    NullOutput output;
+    Validator<NullOutput> validator(json_str, json_str + length, output, check_utf8);
+    return validator.run();
+}
+
+JSONStatus JSON::Validate(const char* str, size_t length) { return CPPJP::Validate(str, length); }
+
+JSONStatus JSON::Validate(const char* str, size_t length, const JSONParseOptions& options)
+{
+    return CPPJP::Validate(str, length, options.validate_utf8);
+}
+
+const char* CPPJP::ErrorCString(JSONError error)
+{
+    switch(error)
+    {
+        case JSONError::NONE:                   return "No error";
+        case JSONError::UNEXPECTED_END:         return "Unexpected end of input";
+        case JSONError::UNEXPECTED_CHARACTER:   return "Unexpected character";
+        case JSONError::INVALID_STRING:         return "Unescaped control character in string";
+        case JSONError::INVALID_ESCAPE:         return "Invalid escape sequence";
+        case JSONError::INVALID_NUMBER:         return "Invalid number";
+        case JSONError::NESTING_TOO_DEEP:       return "Nesting too deep";
+        case JSONError::TRAILING_CHARACTERS:    return "Unexpected characters after the document";
+        case JSONError::INVALID_UTF8:           return "Invalid UTF-8";
+        case JSONError::TYPE_MISMATCH:          return "Value does not match the bound type";
+        case JSONError::READ_FAILED:            return "Failed to read the input";
+        case JSONError::TOO_MANY_NODES:         return "Document has too many values";
+        case JSONError::STRING_TOO_LONG:        return "String is too long";
+        case JSONError::MEMORY_BUDGET_EXCEEDED: return "Document exceeds the memory budget";
+        case JSONError::INVALID_ENCODING:       return "Invalid or unsupported binary encoding";
+    }
+
+    return "Unknown error";
+}
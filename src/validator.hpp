@@ -0,0 +1,352 @@
+#pragma once
+
+#include <cstdint>
+#include "cppjp.hpp"
+#include "scan.hpp"
+#include "utf8.hpp"
+
+/*
+    Allocation free validation of JSON text.
+
+    The validator checks the complete RFC 8259 grammar, and unless told otherwise UTF-8
+    well-formedness of strings, without building a tree. Nesting is tracked in a fixed size bit
+    stack on the C++ stack, one bit per level recording whether the container is an object or an
+    array, so no memory is allocated regardless of input.
+
+    Every token is reported to an Output as it is accepted, which lets text to text passes
+    such as minifying share the validator's single scan. NullOutput reports nowhere and
+    compiles away.
+*/
+
+namespace CPPJP
+{
+    const size_t max_validation_depth = 64 * 1024;
+
+    /*
+        The events a Validator reports. depth is the nesting depth after the event, 0 outside
+        every container.
+    */
+    struct NullOutput
+    {
+        void value(const char*, const char*) {}                 // A string, number or keyword
+        void name(const char*, const char*) {}                  // A member name, followed by its colon
+        void open(char, size_t) {}                              // The first bracket of a non-empty container
+        void close(char, size_t) {}                             // The last bracket of a non-empty container
+        void empty(char, char) {}                               // An empty container
+        void comma(size_t) {}
+    };
+
+    template<typename Output>
+    class Validator
+    {
+        public:
+            Validator(const char* begin, const char* end, Output& output, bool check_utf8 = true)
+                : begin(begin), end(end), depth(0), check_utf8(check_utf8), output(output)
+            {}
+
+            JSONStatus run();
+
+        private:
+            const char* begin;
+            const char* end;
+            size_t depth;
+            bool check_utf8;
+            Output& output;
+            std::uint64_t containers[max_validation_depth / 64]; // Set bit: object, clear bit: array
+
+            JSONStatus fail(JSONError error, const char* at) const
+            {
+                return JSONStatus{ error, static_cast<size_t>(at - begin) };
+            }
+
+            bool push(bool is_object)
+            {
+                if(depth == max_validation_depth) return false;
+
+                std::uint64_t bit = std::uint64_t(1) << (depth % 64);
+                if(is_object) containers[depth / 64] |= bit;
+                else containers[depth / 64] &= ~bit;
+
+                depth++;
+                return true;
+            }
+
+            bool inObject() const
+            {
+                return containers[(depth - 1) / 64] & (std::uint64_t(1) << ((depth - 1) % 64));
+            }
+
+            const char* scanString(const char* ch, JSONStatus& status) const;
+            const char* scanNumber(const char* ch, JSONStatus& status) const;
+            const char* scanName(const char* ch, JSONStatus& status) const;
+    };
+
+    /*
+        Validates the string starting at the opening quote ch.
+        @return A pointer past the closing quote, or nullptr with status set on error.
+    */
+    template<typename Output>
+    const char* Validator<Output>::scanString(const char* ch, JSONStatus& status) const
+    {
+        ch++;
+        const char* body = ch;
+
+        while(true)
+        {
+            ch = CPPJP::FindStringSpecial(ch, end);
+
+            if(ch == end)
+            {
+                status = fail(JSONError::UNEXPECTED_END, ch);
+                return nullptr;
+            }
+
+            if(*ch == '"')
+            {
+                if(!check_utf8) return ch + 1;
+
+                const char* invalid = CPPJP::FindInvalidUTF8(body, ch);
+                if(invalid != ch)
+                {
+                    status = fail(JSONError::INVALID_UTF8, invalid);
+                    return nullptr;
+                }
+                return ch + 1;
+            }
+
+            if(*ch != '\\')
+            {
+                status = fail(JSONError::INVALID_STRING, ch);
+                return nullptr;
+            }
+
+            const char* escape = ch;
+            ch++;
+            if(ch == end)
+            {
+                status = fail(JSONError::UNEXPECTED_END, ch);
+                return nullptr;
+            }
+
+            switch(*ch)
+            {
+                case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+                    ch++;
+                    break;
+
+                case 'u':
+                    if(end - ch < 5)
+                    {
+                        status = fail(JSONError::UNEXPECTED_END, end);
+                        return nullptr;
+                    }
+                    if(!CPPJP::IsHexDigit(ch[1]) || !CPPJP::IsHexDigit(ch[2]) || !CPPJP::IsHexDigit(ch[3]) || !CPPJP::IsHexDigit(ch[4]))
+                    {
+                        status = fail(JSONError::INVALID_ESCAPE, escape);
+                        return nullptr;
+                    }
+                    ch += 5;
+                    break;
+
+                default:
+                    status = fail(JSONError::INVALID_ESCAPE, escape);
+                    return nullptr;
+            }
+        }
+    }
+
+    /*
+        Validates the number starting at ch.
+        @return A pointer past the number, or nullptr with status set on error.
+    */
+    template<typename Output>
+    const char* Validator<Output>::scanNumber(const char* ch, JSONStatus& status) const
+    {
+        const char* start = ch;
+
+        if(*ch == '-') ch++;
+
+        if(ch == end || !CPPJP::IsDigit(*ch))
+        {
+            status = fail(JSONError::INVALID_NUMBER, start);
+            return nullptr;
+        }
+
+        // No leading zeros
+        if(*ch == '0') ch++;
+        else while(ch < end && CPPJP::IsDigit(*ch)) ch++;
+
+        if(ch < end && *ch == '.')
+        {
+            ch++;
+            if(ch == end || !CPPJP::IsDigit(*ch))
+            {
+                status = fail(JSONError::INVALID_NUMBER, start);
+                return nullptr;
+            }
+            while(ch < end && CPPJP::IsDigit(*ch)) ch++;
+        }
+
+        if(ch < end && (*ch == 'e' || *ch == 'E'))
+        {
+            ch++;
+            if(ch < end && (*ch == '+' || *ch == '-')) ch++;
+            if(ch == end || !CPPJP::IsDigit(*ch))
+            {
+                status = fail(JSONError::INVALID_NUMBER, start);
+                return nullptr;
+            }
+            while(ch < end && CPPJP::IsDigit(*ch)) ch++;
+        }
+
+        return ch;
+    }
+
+    /*
+        Validates an object member name and the colon after it.
+        @return A pointer to the start of the member value, or nullptr with status set on error.
+    */
+    template<typename Output>
+    const char* Validator<Output>::scanName(const char* ch, JSONStatus& status) const
+    {
+        if(ch == end)
+        {
+            status = fail(JSONError::UNEXPECTED_END, ch);
+            return nullptr;
+        }
+
+        if(*ch != '"')
+        {
+            status = fail(JSONError::UNEXPECTED_CHARACTER, ch);
+            return nullptr;
+        }
+
+        const char* name = ch;
+        ch = scanString(ch, status);
+        if(!ch) return nullptr;
+
+        output.name(name, ch);
+
+        ch = CPPJP::SkipJSONSpace(ch, end);
+        if(ch == end || *ch != ':')
+        {
+            status = fail(ch == end ? JSONError::UNEXPECTED_END : JSONError::UNEXPECTED_CHARACTER, ch);
+            return nullptr;
+        }
+
+        return CPPJP::SkipJSONSpace(ch + 1, end);
+    }
+
+    template<typename Output>
+    JSONStatus Validator<Output>::run()
+    {
+        JSONStatus status;
+        const char* ch = CPPJP::SkipJSONSpace(begin, end);
+
+        while(true)
+        {
+            // Expecting a value
+            if(ch == end) return fail(JSONError::UNEXPECTED_END, ch);
+
+            bool opened_container = false;
+            const char* token = ch;
+
+            switch(*ch)
+            {
+                case '{':
+                    if(!push(true)) return fail(JSONError::NESTING_TOO_DEEP, ch);
+                    ch = CPPJP::SkipJSONSpace(ch + 1, end);
+                    if(ch < end && *ch == '}')
+                    {
+                        depth--;
+                        ch++;
+                        output.empty('{', '}');
+                        break;
+                    }
+                    output.open('{', depth);
+                    opened_container = true;
+                    break;
+
+                case '[':
+                    if(!push(false)) return fail(JSONError::NESTING_TOO_DEEP, ch);
+                    ch = CPPJP::SkipJSONSpace(ch + 1, end);
+                    if(ch < end && *ch == ']')
+                    {
+                        depth--;
+                        ch++;
+                        output.empty('[', ']');
+                        break;
+                    }
+                    output.open('[', depth);
+                    opened_container = true;
+                    break;
+
+                case '"':
+                    ch = scanString(ch, status);
+                    if(!ch) return status;
+                    output.value(token, ch);
+                    break;
+
+                case 't':
+                    if(end - ch < 4 || ch[1] != 'r' || ch[2] != 'u' || ch[3] != 'e') return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+                    ch += 4;
+                    output.value(token, ch);
+                    break;
+
+                case 'f':
+                    if(end - ch < 5 || ch[1] != 'a' || ch[2] != 'l' || ch[3] != 's' || ch[4] != 'e') return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+                    ch += 5;
+                    output.value(token, ch);
+                    break;
+
+                case 'n':
+                    if(end - ch < 4 || ch[1] != 'u' || ch[2] != 'l' || ch[3] != 'l') return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+                    ch += 4;
+                    output.value(token, ch);
+                    break;
+
+                default:
+                    if(*ch != '-' && !CPPJP::IsDigit(*ch)) return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+                    ch = scanNumber(ch, status);
+                    if(!ch) return status;
+                    output.value(token, ch);
+                    break;
+            }
+
+            if(opened_container)
+            {
+                // ch is at the first member of a non-empty container
+                if(inObject() && !(ch = scanName(ch, status))) return status;
+                continue;
+            }
+
+            // A value has been completed, close containers until another value is expected
+            while(true)
+            {
+                ch = CPPJP::SkipJSONSpace(ch, end);
+
+                if(depth == 0)
+                {
+                    if(ch != end) return fail(JSONError::TRAILING_CHARACTERS, ch);
+                    return status;
+                }
+
+                if(ch == end) return fail(JSONError::UNEXPECTED_END, ch);
+
+                if(*ch == ',')
+                {
+                    output.comma(depth);
+                    ch = CPPJP::SkipJSONSpace(ch + 1, end);
+                    if(inObject() && !(ch = scanName(ch, status))) return status;
+                    break;
+                }
+
+                if(*ch != (inObject() ? '}' : ']')) return fail(JSONError::UNEXPECTED_CHARACTER, ch);
+
+                depth--;
+                output.close(*ch, depth);
+                ch++;
+            }
+        }
+    }
+}